@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
+#include <sstream>
 #include <argparse/argparse.hpp>
 #include "FrequencySpectrum.hpp"
 #include "termviz.hpp"
@@ -14,13 +17,17 @@ class Args : private ArgumentParser
 	using InterpType = FrequencySpectrum::InterpType;
 	using AccumulationMethod = FrequencySpectrum::AccumulationMethod;
 	using WindowFunction = FrequencySpectrum::WindowFunction;
+	using PlannerRigor = FrequencySpectrum::PlannerRigor;
 
 public:
 	Args(const int argc, const char *const *const argv)
 		: ArgumentParser(argv[0])
 	{
 		add_argument("audio_file")
-			.help("audio file to visualize and play");
+			.help("audio file to visualize and play, or '-' for raw pcm on stdin (see --stdin)")
+			.nargs(argparse::nargs_pattern::optional);
+		add_argument("--stdin")
+			.help("read raw interleaved pcm from stdin, formatted as ENCODING:RATE:CHANNELS, e.g. f32le:48000:2\nencodings: f32le, s16le. implied as f32le:44100:2 by an audio file of '-'");
 
 		add_argument("-n", "--sample-size")
 			.help("number of samples (or frames of samples) to process at a time\n- higher -> increases accuracy\n- lower -> increases responsiveness")
@@ -28,6 +35,25 @@ public:
 			.scan<'i', int>()
 			.validate();
 
+		add_argument("--fps")
+			.help("video frames per second, need not be an integer (e.g. 59.94)\nframes are timed against the audio clock; frames that can't be drawn in time are dropped")
+			.default_value(60.f)
+			.scan<'f', float>()
+			.validate();
+
+		add_argument("--hop")
+			.help("audio frames between video frames, instead of --fps. independent of the sample size:\na large -n with a small hop keeps bass resolution and smooth motion")
+			.scan<'i', int>();
+		add_argument("--overlap")
+			.help("fraction of the sample size consecutive windows share, in [0, 1), instead of --fps or --hop\ne.g. -n 16384 --overlap 0.75 hops 4096 frames at a time")
+			.scan<'f', float>();
+
+		add_argument("--fft-planner")
+			.help("how hard fftw should look for a fast fft plan\n- 'measure' and above are slow the first time for a given sample size,\n  then cached in $XDG_CACHE_HOME/termviz")
+			.choices("estimate", "measure", "patient", "exhaustive")
+			.default_value("estimate")
+			.validate();
+
 		add_argument("-c", "--spectrum-chars")
 			.help("characters to render columns with\nif more than 1 character is given, --peak-char is recommended")
 			.default_value("#");
@@ -40,9 +66,9 @@ public:
 			.default_value("log")
 			.validate();
 		add_argument("--nth-root")
-			.help("set the root to use with '--scale nth-root'")
-			.default_value(2.f)
-			.scan<'f', float>()
+			.help("set the root to use with '--scale nth-root', a whole number of at least 1")
+			.default_value(2)
+			.scan<'i', int>()
 			.validate();
 
 		add_argument("-a", "--accum")
@@ -54,9 +80,14 @@ public:
 
 		add_argument("-w", "--window")
 			.help("set window function to use, or 'none'.\nwindow functions can reduce 'wiggling' in bass frequencies.\nhowever they can reduce overall amplitude, so adjust '-m' accordingly.")
-			.choices("none", "hanning", "hamming", "blackman")
+			.choices("none", "hanning", "hamming", "blackman", "blackman-harris", "nuttall", "flattop", "kaiser")
 			.default_value("blackman")
 			.validate();
+		add_argument("--kaiser-beta")
+			.help("set the beta (shape) parameter to use with '--window kaiser'\n- higher -> lower side lobes, wider main lobe")
+			.default_value(8.6f)
+			.scan<'f', float>()
+			.validate();
 
 		add_argument("-i", "--interpolation")
 			.help("spectrum interpolation type")
@@ -72,7 +103,7 @@ public:
 
 		add_argument("--color")
 			.help("enable a colorful spectrum!")
-			.choices("wheel", "solid", "none")
+			.choices("wheel", "solid", "gradient", "none")
 			.default_value("wheel")
 			.validate();
 		add_argument("--wheel-rate")
@@ -88,6 +119,76 @@ public:
 			.help("requires '--color solid'\nrenders the spectrum with a solid color\nmust provide space-separated rgb integers")
 			.nargs(3)
 			.validate();
+		add_argument("--gradient")
+			.help("requires '--color gradient'\ncolors the spectrum with a gradient through these colors, from left to right\nmust provide space-separated hex colors, e.g. ff0000 ffff00 00ffff")
+			.nargs(argparse::nargs_pattern::at_least_one)
+			.validate();
+		add_argument("--gradient-space")
+			.help("requires '--color gradient'\nblend gradient colors in linear-light 'rgb', or in 'hsv' going around the hue wheel")
+			.choices("rgb", "hsv")
+			.default_value("rgb")
+			.validate();
+		add_argument("--color-depth")
+			.help("colors to send the terminal\n- 'auto': the most the terminal supports (COLORTERM, terminfo) and its measured\n  throughput can keep up with, lowered while playing if output starts blocking\n- '256' and '16' map every color to the nearest palette entry")
+			.choices("auto", "truecolor", "256", "16")
+			.default_value("auto")
+			.validate();
+
+		add_argument("--lookahead-jobs")
+			.help("compute spectra ahead of playback on this many threads, so large sample sizes\nand interpolation don't compete with drawing. 0 computes them on the playback thread")
+			.default_value(0)
+			.scan<'i', int>()
+			.validate();
+
+		add_argument("--spectrum-cache")
+			.help("cache every frame's spectra in $XDG_CACHE_HOME/termviz/spectra the first time a file is played\nwith a given sample size, window, scale, accumulation and interpolation, and replay from it")
+			.flag();
+		add_argument("--spectrum-cache-size")
+			.help("size cap of the spectrum cache in MiB, least recently played files are evicted first")
+			.default_value(1024)
+			.scan<'i', int>()
+			.validate();
+
+		add_argument("--pcm-cache")
+			.help("decode the file once into $XDG_CACHE_HOME/termviz/pcm in the background,\nthen play and analyse from a memory mapping of it. speeds up compressed files")
+			.flag();
+		add_argument("--pcm-cache-size")
+			.help("size cap of the pcm cache in MiB, least recently played files are evicted first")
+			.default_value(4096)
+			.scan<'i', int>()
+			.validate();
+
+		add_argument("--audio-sink")
+			.help("where audio is played\n- 'portaudio': the default output device\n- 'null': nowhere, timed by the monotonic clock like a device, for hosts without one\n- 'wav:FILE': written to a float wav file, timed like 'null'")
+			.default_value("portaudio");
+		add_argument("--free-running")
+			.help("requires '--audio-sink null' or 'wav:FILE'\ndon't play in real time: audio only advances once the frame before is rendered,\nso every frame is rendered as fast as possible and none are dropped")
+			.flag();
+
+		add_argument("--stereo")
+			.help("render a mirrored spectrum: left channel on the left half, right channel on the right half")
+			.flag();
+
+		add_argument("--stats")
+			.help("time every stage of each frame: show p50/p99/max latencies on the top row,\nand print them with the average bytes and write syscalls per frame on exit")
+			.flag();
+		add_argument("--stats-json")
+			.help("time every stage of each frame and dump the latency histograms as json to this file on exit");
+
+		add_argument("--render-to")
+			.help("don't play anything: render every frame of the file to this file as fast as possible, using all cores");
+		add_argument("--render-format")
+			.help("requires '--render-to'\n- 'asciicast': asciicast v2 recording with frame timestamps\n- 'ansi': raw terminal output")
+			.choices("asciicast", "ansi")
+			.default_value("asciicast")
+			.validate();
+		add_argument("--render-size")
+			.help("requires '--render-to'\nsize to render at as COLSxROWS, defaults to the terminal's size or 80x24");
+		add_argument("--render-jobs")
+			.help("requires '--render-to'\nnumber of threads to render with, 0 for one per core")
+			.default_value(0)
+			.scan<'i', int>()
+			.validate();
 
 		try
 		{
@@ -106,14 +207,75 @@ public:
 
 	std::unique_ptr<termviz> to_termviz()
 	{
-		std::unique_ptr<termviz> tv(new termviz(get("audio_file")));
+		std::unique_ptr<termviz> tv;
+		{ // input: a file, or a pcm stream on stdin
+			const auto audio_file = present("audio_file");
+			const auto stdin_format = present("--stdin");
+			if (stdin_format && audio_file && *audio_file != "-")
+				throw std::invalid_argument("--stdin cannot be used with an audio file");
+			if (stdin_format)
+				tv.reset(new termviz(PcmPipe::Format::parse(*stdin_format)));
+			else if (audio_file && *audio_file == "-")
+				tv.reset(new termviz(PcmPipe::Format{}));
+			else if (audio_file)
+				tv.reset(new termviz(*audio_file));
+			else
+				throw std::invalid_argument("no audio file given, and no --stdin");
+		}
+
+		// before the sample size and planner, since changing the channel count re-plans the fft
+		tv->set_stereo(get<bool>("--stereo"));
 
 		int fft_size;
 		if ((fft_size = get<int>("-n")) & 1)
 			throw std::invalid_argument("sample size must be even!");
 		tv->set_sample_size(fft_size);
 
+		{ // fft planner rigor, after the sample size so only the final size is planned
+			const auto &planner_str = get("--fft-planner");
+			if (planner_str == "estimate")
+				tv->set_fft_planner(PlannerRigor::ESTIMATE);
+			else if (planner_str == "measure")
+				tv->set_fft_planner(PlannerRigor::MEASURE);
+			else if (planner_str == "patient")
+				tv->set_fft_planner(PlannerRigor::PATIENT);
+			else if (planner_str == "exhaustive")
+				tv->set_fft_planner(PlannerRigor::EXHAUSTIVE);
+			else
+				throw std::invalid_argument("unknown fft planner: " + planner_str);
+		}
+
+		{ // frame timing: a hop, a window overlap or a frame rate
+			const auto hop = present<int>("--hop");
+			const auto overlap = present<float>("--overlap");
+			if (hop && overlap)
+				throw std::invalid_argument("--hop and --overlap cannot be used together");
+			if (hop)
+				tv->set_hop(*hop);
+			else if (overlap)
+			{
+				if (*overlap < 0 || *overlap >= 1)
+					throw std::invalid_argument("overlap must be in [0, 1)!");
+				tv->set_hop(std::max(1L, std::lround(fft_size * (1 - *overlap))));
+			}
+			else
+				tv->set_fps(get<float>("--fps"));
+		}
+		tv->set_lookahead_jobs(get<int>("--lookahead-jobs"));
+		tv->set_pcm_cache(get<bool>("--pcm-cache"));
+		if (const auto cache_mib = get<int>("--pcm-cache-size"); cache_mib >= 0)
+			tv->set_pcm_cache_size((uintmax_t)cache_mib << 20);
+		else
+			throw std::invalid_argument("pcm cache size cannot be negative!");
+		tv->set_spectrum_cache(get<bool>("--spectrum-cache"));
+		if (const auto cache_mib = get<int>("--spectrum-cache-size"); cache_mib >= 0)
+			tv->set_spectrum_cache_size((uintmax_t)cache_mib << 20);
+		else
+			throw std::invalid_argument("spectrum cache size cannot be negative!");
 		tv->set_characters(get("-c"));
+		tv->set_stats_overlay(get<bool>("--stats"));
+		if (const auto path = present("--stats-json"))
+			tv->set_stats_json(*path);
 		tv->set_multiplier(get<float>("-m"));
 
 		// peak character
@@ -135,6 +297,31 @@ public:
 				throw std::invalid_argument("unknown accumulation methpd: " + acc_method_str);
 		}
 
+		{ // window function
+			const auto &wf_str = get("-w");
+			if (wf_str == "none")
+				tv->set_window_function(WindowFunction::NONE);
+			else if (wf_str == "hanning")
+				tv->set_window_function(WindowFunction::HANNING);
+			else if (wf_str == "hamming")
+				tv->set_window_function(WindowFunction::HAMMING);
+			else if (wf_str == "blackman")
+				tv->set_window_function(WindowFunction::BLACKMAN);
+			else if (wf_str == "blackman-harris")
+				tv->set_window_function(WindowFunction::BLACKMAN_HARRIS);
+			else if (wf_str == "nuttall")
+				tv->set_window_function(WindowFunction::NUTTALL);
+			else if (wf_str == "flattop")
+				tv->set_window_function(WindowFunction::FLATTOP);
+			else if (wf_str == "kaiser")
+			{
+				tv->set_kaiser_beta(get<float>("--kaiser-beta"));
+				tv->set_window_function(WindowFunction::KAISER);
+			}
+			else
+				throw std::invalid_argument("unknown window function: " + wf_str);
+		}
+
 		{ // interpolation type
 			const auto &interp_str = get("-i");
 			if (interp_str == "none")
@@ -166,12 +353,58 @@ public:
 				if (rgb_strs.size())
 					tv->set_solid_color({std::stoi(rgb_strs[0]), std::stoi(rgb_strs[1]), std::stoi(rgb_strs[2])});
 			}
+			else if (color_str == "gradient")
+			{
+				tv->set_color_type(ColorType::GRADIENT);
+				std::vector<std::tuple<int, int, int>> colors;
+				for (auto hex : get<std::vector<std::string>>("--gradient"))
+				{
+					if (hex.starts_with('#'))
+						hex.erase(0, 1);
+					size_t end;
+					const auto rgb = std::stoul(hex, &end, 16);
+					if (hex.size() != 6 || end != 6)
+						throw std::invalid_argument("gradient colors must be 6 digit hex colors: " + hex);
+					colors.emplace_back((rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff);
+				}
+				if (colors.empty())
+					throw std::invalid_argument("'--color gradient' requires '--gradient'");
+				tv->set_gradient(colors, (get("--gradient-space") == "hsv") ? termviz::GradientSpace::HSV : termviz::GradientSpace::RGB);
+			}
 			else if (color_str == "none")
 				tv->set_color_type(ColorType::NONE);
 			else
 				throw std::invalid_argument("unknown coloring type: " + color_str);
 		}
 
+		{ // color depth, left automatic unless given
+			const auto &depth_str = get("--color-depth");
+			if (depth_str == "truecolor")
+				tv->set_color_depth(ColorDepth::TRUECOLOR);
+			else if (depth_str == "256")
+				tv->set_color_depth(ColorDepth::COLOR_256);
+			else if (depth_str == "16")
+				tv->set_color_depth(ColorDepth::COLOR_16);
+			else if (depth_str != "auto")
+				throw std::invalid_argument("unknown color depth: " + depth_str);
+		}
+
+		{ // audio sink
+			const auto &sink_str = get("--audio-sink");
+			const bool realtime = !get<bool>("--free-running");
+			if (sink_str == "null")
+				tv->set_audio_sink(AudioSink::Type::NULL_SINK, {}, realtime);
+			else if (sink_str.starts_with("wav:"))
+				tv->set_audio_sink(AudioSink::Type::WAV, sink_str.substr(4), realtime);
+			else if (sink_str == "portaudio")
+			{
+				if (!realtime)
+					throw std::invalid_argument("'--free-running' requires '--audio-sink null' or 'wav:FILE'");
+			}
+			else
+				throw std::invalid_argument("unknown audio sink: " + sink_str);
+		}
+
 		{ // frequency scale (x-axis)
 			const auto &scale_str = get("-s");
 			if (scale_str == "linear")
@@ -181,15 +414,40 @@ public:
 			else if (scale_str == "nth-root")
 			{
 				tv->set_scale(Scale::NTH_ROOT);
-				const auto nth_root = get<float>("--nth-root");
-				if (!nth_root)
-					throw std::invalid_argument("nth_root cannot be zero!");
+				const auto nth_root = get<int>("--nth-root");
+				if (nth_root < 1)
+					throw std::invalid_argument("nth_root must be at least 1!");
 				tv->set_nth_root(nth_root);
 			}
 			else
 				throw std::invalid_argument("unknown scale: " + scale_str);
 		}
 
+		if (const auto path = present("--render-to"))
+		{
+			tv->set_render_file(*path);
+
+			const auto &format_str = get("--render-format");
+			if (format_str == "asciicast")
+				tv->set_render_format(termviz::RenderFormat::ASCIICAST);
+			else if (format_str == "ansi")
+				tv->set_render_format(termviz::RenderFormat::ANSI);
+			else
+				throw std::invalid_argument("unknown render format: " + format_str);
+
+			if (const auto size = present("--render-size"))
+			{
+				int cols, rows;
+				char x;
+				std::istringstream ss(*size);
+				if (!(ss >> cols >> x >> rows) || x != 'x' || !ss.eof())
+					throw std::invalid_argument("render size must look like COLSxROWS: " + *size);
+				tv->set_render_size(cols, rows);
+			}
+
+			tv->set_render_jobs(get<int>("--render-jobs"));
+		}
+
 		return tv;
 	}
 };
\ No newline at end of file
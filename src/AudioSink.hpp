@@ -0,0 +1,230 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sndfile.hh>
+#include "PortAudio.hpp"
+
+/**
+ * Where played audio goes. Every sink pulls interleaved float frames from the same callback, and reports
+ * when each buffer will be heard on its own clock, so `AudioClock` and frame scheduling work the same with any of them.
+ */
+class AudioSink
+{
+public:
+	enum class Type
+	{
+		PORTAUDIO,
+		NULL_SINK,
+		WAV
+	};
+
+	/**
+	 * Fill `output` with up to `n_frames` interleaved frames, which will be heard at `time` on the sink's clock (negative if unknown).
+	 * @returns frames provided. sinks that aren't `realtime` only advance by these, sinks that are play the rest as silence
+	 */
+	using Callback = size_t (*)(float *output, size_t n_frames, double time, void *user_data);
+
+	virtual ~AudioSink() = default;
+
+	// current time on the clock of the callback's `time`, in seconds
+	virtual double time() const = 0;
+
+	// whether the sink plays in real time on its own thread. otherwise it only plays from `pump`, as fast as audio is provided
+	virtual bool realtime() const { return true; }
+
+	/**
+	 * Play as much as the callback provides, on the calling thread. Does nothing for `realtime` sinks.
+	 * @returns frames played
+	 */
+	virtual size_t pump() { return 0; }
+
+	// pause and resume calling the callback
+	virtual void stop() = 0;
+	virtual void start() = 0;
+};
+
+// the default output device
+class PortAudioSink : public AudioSink
+{
+	Callback callback;
+	void *user_data;
+	PortAudio pa;
+	std::unique_ptr<PortAudio::Stream> stream;
+
+public:
+	PortAudioSink(const int channels, const int samplerate, const Callback callback, void *const user_data)
+		: callback(callback),
+		  user_data(user_data),
+		  stream(pa.open_stream(0, channels, paFloat32, samplerate, paFramesPerBufferUnspecified, play, this))
+	{
+	}
+
+	double time() const override { return stream->time(); }
+	void stop() override { stream->stop(); }
+	void start() override { stream->start(); }
+
+private:
+	static int play(const void *, void *output, unsigned long frame_count, const PaStreamCallbackTimeInfo *time_info, PaStreamCallbackFlags, void *user_data)
+	{
+		const auto self = static_cast<PortAudioSink *>(user_data);
+		// some host apis don't report the dac time
+		const auto time = !time_info ? 0 : time_info->outputBufferDacTime ? time_info->outputBufferDacTime : time_info->currentTime;
+		self->callback(static_cast<float *>(output), frame_count, time ? time : -1, self->user_data);
+		return paContinue;
+	}
+};
+
+/**
+ * Discards audio, for hosts without an audio device.
+ * In real time, a thread plays fixed-size buffers on deadlines from the monotonic clock, like a device would.
+ * Free-running, audio is played from `pump` as soon as it is provided, and the clock is the audio played so far.
+ * See `WavSink` to keep what is played.
+ */
+class NullSink : public AudioSink
+{
+	using Clock = std::chrono::steady_clock;
+
+	// frames per callback, about 12ms at 44.1kHz
+	static constexpr size_t block = 512;
+
+	Callback callback;
+	void *user_data;
+	int samplerate;
+	bool is_realtime;
+
+	std::vector<float> buffer;
+
+	// everything played is written here if opened
+	SndfileHandle wav;
+
+	// frames played so far, and when the first one was heard. the clock starts at 0
+	std::atomic<uint64_t> played = 0;
+	Clock::time_point begin;
+
+	std::thread thread;
+	std::atomic<bool> stopping = false;
+
+public:
+	/**
+	 * @param realtime whether to play in real time, or as fast as `pump` is called
+	 */
+	NullSink(const int channels, const int samplerate, const Callback callback, void *const user_data, const bool realtime)
+		: NullSink(channels, samplerate, callback, user_data, realtime, {})
+	{
+	}
+
+	~NullSink() override
+	{
+		stop();
+	}
+
+	NullSink(const NullSink &) = delete;
+	NullSink &operator=(const NullSink &) = delete;
+
+	double time() const override
+	{
+		if (is_realtime)
+			return std::chrono::duration<double>(Clock::now() - begin).count();
+		return (double)played.load(std::memory_order_acquire) / samplerate;
+	}
+
+	bool realtime() const override { return is_realtime; }
+
+	size_t pump() override
+	{
+		if (is_realtime)
+			return 0;
+		size_t total = 0;
+		for (;;)
+		{
+			const auto p = played.load(std::memory_order_relaxed);
+			const auto n = std::min(callback(buffer.data(), block, (double)p / samplerate, user_data), block);
+			write(buffer.data(), n);
+			played.store(p + n, std::memory_order_release);
+			total += n;
+			if (n < block)
+				return total;
+		}
+	}
+
+	void stop() override
+	{
+		if (!thread.joinable())
+			return;
+		stopping = true;
+		thread.join();
+	}
+
+	void start() override
+	{
+		if (!is_realtime || thread.joinable())
+			return;
+		// resume the clock where it stopped
+		begin = Clock::now() - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((double)played / samplerate));
+		stopping = false;
+		thread = std::thread(&NullSink::run, this);
+	}
+
+protected:
+	/**
+	 * @param wav_path float wav file to write everything played to, or empty to discard it
+	 * @throws `std::runtime_error` if `wav_path` cannot be opened
+	 */
+	NullSink(const int channels, const int samplerate, const Callback callback, void *const user_data, const bool realtime, const std::string &wav_path)
+		: callback(callback),
+		  user_data(user_data),
+		  samplerate(samplerate),
+		  is_realtime(realtime),
+		  buffer(block * channels)
+	{
+		if (!wav_path.empty())
+		{
+			wav = SndfileHandle(wav_path, SFM_WRITE, SF_FORMAT_WAV | SF_FORMAT_FLOAT, channels, samplerate);
+			if (!wav || wav.error())
+				throw std::runtime_error("cannot open wav file: " + wav_path + ": " + wav.strError());
+		}
+		start();
+	}
+
+private:
+	void write(const float *const frames, const size_t n_frames)
+	{
+		if (wav)
+			wav.writef(frames, n_frames);
+	}
+
+	void run()
+	{
+		while (!stopping.load(std::memory_order_relaxed))
+		{
+			const auto p = played.load(std::memory_order_relaxed);
+			callback(buffer.data(), block, (double)p / samplerate, user_data);
+			write(buffer.data(), block);
+			played.store(p + block, std::memory_order_release);
+			// deadlines come from the frame count, so rounding never accumulates into drift
+			std::this_thread::sleep_until(begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((double)(p + block) / samplerate)));
+		}
+	}
+};
+
+// plays like `NullSink`, and writes everything played to a float wav file, including silence from underruns
+class WavSink : public NullSink
+{
+public:
+	/**
+	 * @param path wav file to create or overwrite
+	 * @param realtime whether to play in real time, or as fast as `pump` is called
+	 * @throws `std::runtime_error` if `path` cannot be opened
+	 */
+	WavSink(const std::string &path, const int channels, const int samplerate, const Callback callback, void *const user_data, const bool realtime)
+		: NullSink(channels, samplerate, callback, user_data, realtime, path)
+	{
+	}
+};
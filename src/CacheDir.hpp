@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace CacheDir
+{
+	/**
+	 * Get termviz's cache directory, `$XDG_CACHE_HOME/termviz` (or `~/.cache/termviz`), creating it if needed.
+	 * @throws `std::runtime_error` if neither `XDG_CACHE_HOME` nor `HOME` is set
+	 * @throws `std::filesystem::filesystem_error` if the directory can't be created
+	 */
+	std::filesystem::path path()
+	{
+		std::filesystem::path dir;
+		if (const auto xdg = getenv("XDG_CACHE_HOME"); xdg && *xdg)
+			dir = xdg;
+		else if (const auto home = getenv("HOME"); home && *home)
+			dir = std::filesystem::path(home) / ".cache";
+		else
+			throw std::runtime_error("CacheDir::path: neither XDG_CACHE_HOME nor HOME is set");
+		dir /= "termviz";
+		std::filesystem::create_directories(dir);
+		return dir;
+	}
+
+	// 64-bit fnv-1a over whole words, then the tail bytes; pass the previous result as `h` to continue a hash
+	uint64_t hash(const char *const p, const size_t n, uint64_t h = 14695981039346656037ull)
+	{
+		size_t i = 0;
+		for (uint64_t word; i + 8 <= n; i += 8)
+		{
+			memcpy(&word, p + i, 8);
+			h = (h ^ word) * 1099511628211ull;
+		}
+		for (; i < n; ++i)
+			h = (h ^ (unsigned char)p[i]) * 1099511628211ull;
+		return h;
+	}
+
+	/**
+	 * Hash the whole content of a file, for naming cache entries derived from it.
+	 * @throws `std::runtime_error` if the file can't be read
+	 */
+	uint64_t hash_file(const std::string &path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			throw std::runtime_error("cannot open file: " + path);
+		std::vector<char> buf(1 << 20);
+		uint64_t h = hash(nullptr, 0);
+		while (file.read(buf.data(), buf.size()) || file.gcount())
+			h = hash(buf.data(), file.gcount(), h);
+		return h;
+	}
+
+	/**
+	 * Remove the least recently used files with extension `extension` in `dir` until they add up to at most `max_bytes`.
+	 * A file's modification time is taken as its last use, so cache hits should touch it.
+	 * @param keep file that is never removed, e.g. the one just created
+	 * @param reserve bytes of a file about to be added that isn't in `dir` yet, which count towards `max_bytes`
+	 */
+	void evict(const std::filesystem::path &dir, const std::string &extension, const uintmax_t max_bytes, const std::filesystem::path &keep,
+			   const uintmax_t reserve = 0)
+	{
+		struct Entry
+		{
+			std::filesystem::path path;
+			std::filesystem::file_time_type used;
+			uintmax_t size;
+		};
+		std::vector<Entry> entries;
+		uintmax_t total = reserve;
+		for (const auto &e : std::filesystem::directory_iterator(dir))
+			if (e.is_regular_file() && e.path().extension() == extension)
+			{
+				entries.push_back({e.path(), e.last_write_time(), e.file_size()});
+				total += entries.back().size;
+			}
+
+		std::ranges::sort(entries, {}, &Entry::used);
+		for (const auto &e : entries)
+		{
+			if (total <= max_bytes)
+				break;
+			if (e.path == keep)
+				continue;
+			std::filesystem::remove(e.path);
+			total -= e.size;
+		}
+	}
+
+	// mark a cache file as just used, for `evict`
+	void touch(const std::filesystem::path &path)
+	{
+		std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now());
+	}
+};
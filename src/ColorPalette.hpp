@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// how many colors the terminal is sent, cheapest first
+enum class ColorDepth
+{
+	COLOR_16,
+	COLOR_256,
+	TRUECOLOR
+};
+
+/**
+ * Nearest-color lookup tables for quantizing 24-bit colors to the xterm 16 and 256 color palettes.
+ * Tables are indexed by 5:5:5 rgb and built once, so quantizing a color is a single load.
+ */
+namespace ColorPalette
+{
+	// 32768 entries: 5 bits per channel is finer than the gaps between palette colors
+	constexpr int KEY_BITS = 5;
+	using Table = std::array<uint8_t, 1 << (3 * KEY_BITS)>;
+
+	// table index of packed 0xRRGGBB
+	constexpr uint32_t key(const uint32_t rgb)
+	{
+		constexpr int drop = 8 - KEY_BITS;
+		return ((rgb >> (16 + drop)) & 0x1f) << 10 | ((rgb >> (8 + drop)) & 0x1f) << 5 | ((rgb >> drop) & 0x1f);
+	}
+
+	// xterm's default rgb of palette color `i`. terminals let users change colors 0-15, so they are only approximate.
+	constexpr uint32_t xterm_rgb(const int i)
+	{
+		constexpr uint32_t system[16] = {
+			0x000000, 0xcd0000, 0x00cd00, 0xcdcd00, 0x0000ee, 0xcd00cd, 0x00cdcd, 0xe5e5e5,
+			0x7f7f7f, 0xff0000, 0x00ff00, 0xffff00, 0x5c5cff, 0xff00ff, 0x00ffff, 0xffffff};
+		constexpr uint32_t cube[6] = {0, 95, 135, 175, 215, 255};
+		if (i < 16)
+			return system[i];
+		if (i < 232)
+			return cube[(i - 16) / 36] << 16 | cube[(i - 16) / 6 % 6] << 8 | cube[(i - 16) % 6];
+		const uint32_t gray = 8 + (i - 232) * 10;
+		return gray << 16 | gray << 8 | gray;
+	}
+
+	// squared distance, with green weighted most and blue least like the eye does
+	constexpr int distance(const uint32_t a, const uint32_t b)
+	{
+		const int dr = (int)((a >> 16) & 0xff) - (int)((b >> 16) & 0xff);
+		const int dg = (int)((a >> 8) & 0xff) - (int)((b >> 8) & 0xff);
+		const int db = (int)(a & 0xff) - (int)(b & 0xff);
+		return 3 * dr * dr + 4 * dg * dg + 2 * db * db;
+	}
+
+	// palette colors [first, last) nearest to the center of every table cell
+	Table build(const int first, const int last)
+	{
+		Table table;
+		for (uint32_t k = 0; k < table.size(); ++k)
+		{
+			constexpr int drop = 8 - KEY_BITS, half = 1 << (drop - 1);
+			const uint32_t rgb = ((k >> 10) << drop | half) << 16 | (((k >> 5) & 0x1f) << drop | half) << 8 | ((k & 0x1f) << drop | half);
+			int best = first, best_distance = distance(rgb, xterm_rgb(first));
+			for (int i = first + 1; i < last; ++i)
+				if (const auto d = distance(rgb, xterm_rgb(i)); d < best_distance)
+					best = i, best_distance = d;
+			table[k] = best;
+		}
+		return table;
+	}
+
+	/**
+	 * @param depth `COLOR_16` or `COLOR_256`
+	 * @returns the table of nearest palette colors for `depth`, built on first use.
+	 * 256 color mode only picks from the color cube and gray ramp, which terminals don't remap.
+	 */
+	const Table &nearest(const ColorDepth depth)
+	{
+		if (depth == ColorDepth::COLOR_16)
+		{
+			static const Table table16 = build(0, 16);
+			return table16;
+		}
+		static const Table table256 = build(16, 256);
+		return table256;
+	}
+}
@@ -1,84 +1,170 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <tuple>
+#include <utility>
 #include <stdexcept>
 #include <cmath>
+#include <vector>
 
 namespace ColorUtils
 {
-	std::tuple<int, int, int> hsvToRgb(float h, const float s, const float v)
+	// pack channels in [0, 1] as 0xRRGGBB
+	uint32_t pack_rgb(const float r, const float g, const float b)
 	{
-		if (s < 0 || s > 1 || v < 0 || v > 1)
-			throw std::invalid_argument("s and v should be in the range [0, 1]");
+		// through int, since x86 can only convert floats to signed integers in bulk
+		return (uint32_t)((int)(r * 255 + .5f) << 16 | (int)(g * 255 + .5f) << 8 | (int)(b * 255 + .5f));
+	}
 
-		// Normalize h to the range [0, 1]
-		h = std::fmod(h, 1);
+	/**
+	 * Convert `n` hsv colors to packed 0xRRGGBB, without branches so the loop vectorizes.
+	 * Every channel of a color is `v - v * s * clamp(2 - |k - 2|, 0, 1)` with `k = (n + 6h) mod 6`,
+	 * for n = 5, 3 and 1, which is the same as the usual six-way switch over the hue's sector.
+	 * Floors go through int and clamps through `fabs`, since gcc won't turn float comparisons into selects
+	 * without -fno-trapping-math.
+	 * @param h hues, wrapping every 1, with magnitudes below 2^31
+	 * @param s saturations in [0, 1]
+	 * @param v values in [0, 1]
+	 * @param rgb destination, `n` colors long
+	 */
+	void hsv_to_rgb(const float *const h, const float *const s, const float *const v, uint32_t *const rgb, const int n)
+	{
+		const auto channel = [](const float offset, const float h6, const float c, const float v)
+		{
+			// k is in [1, 11), so truncating is flooring
+			auto k = offset + h6;
+			k -= 6 * (float)(int)(k * (1.f / 6));
+			const auto x = 2 - std::fabs(k - 2);
+			return v - c * (std::fabs(x) - std::fabs(x - 1) + 1) * .5f;
+		};
+		for (int i = 0; i < n; ++i)
+		{
+			// fractional part, also of negative hues
+			auto fraction = h[i] - (float)(int)h[i];
+			fraction += (float)(fraction < 0);
+			const auto h6 = fraction * 6;
+			const auto c = v[i] * s[i];
+			rgb[i] = pack_rgb(channel(5, h6, c, v[i]), channel(3, h6, c, v[i]), channel(1, h6, c, v[i]));
+		}
+	}
 
-		// Ensure h is not negative
-		if (h < 0)
-			h += 1;
+	// hsv of rgb, all channels in [0, 1]; the hue of grays is 0
+	std::tuple<float, float, float> rgb_to_hsv(const float r, const float g, const float b)
+	{
+		const auto max = std::max({r, g, b}), min = std::min({r, g, b}), c = max - min;
+		float h = 0;
+		if (c > 0)
+		{
+			if (max == r)
+				h = (g - b) / c;
+			else if (max == g)
+				h = (b - r) / c + 2;
+			else
+				h = (r - g) / c + 4;
+			h /= 6;
+			h -= std::floor(h);
+		}
+		return {h, max ? (c / max) : 0, max};
+	}
 
-		double r, g, b;
+	/**
+	 * A multi-stop color gradient, sampled into lookup tables so that coloring with it costs one load.
+	 * Colors between stops are interpolated in hsv (hues linearly, so a stop at hue 1.5 goes around the wheel
+	 * past red), or in linear-light rgb, which blends without the dark band that blending srgb values gives.
+	 */
+	class Gradient
+	{
+	public:
+		enum class Space
+		{
+			HSV,
+			RGB
+		};
 
-		if (s == 0)
-			r = g = b = v;
-		else
+		struct Stop
 		{
-			double var_h = h * 6;
-			if (var_h == 6)
-				var_h = 0;
+			// where the stop is along the gradient, in [0, 1]
+			float position;
 
-			int var_i = var_h;
-			double var_1 = v * (1 - s);
-			double var_2 = v * (1 - s * (var_h - var_i));
-			double var_3 = v * (1 - s * (1 - (var_h - var_i)));
+			// hue, saturation, value for `HSV`, or srgb red, green, blue for `RGB`; all in [0, 1] except hues
+			float a, b, c;
+		};
 
-			switch (var_i)
+	private:
+		Space space;
+
+		// with `RGB`, channels are stored in linear light
+		std::vector<Stop> stops;
+
+		static float srgb_to_linear(const float x)
+		{
+			return (x <= .04045f) ? (x / 12.92f) : std::pow((x + .055f) / 1.055f, 2.4f);
+		}
+
+		static float linear_to_srgb(const float x)
+		{
+			return (x <= .0031308f) ? (x * 12.92f) : (1.055f * std::pow(x, 1 / 2.4f) - .055f);
+		}
+
+	public:
+		/**
+		 * @param space color space to interpolate in
+		 * @param stops at least one stop, in nondecreasing order of position
+		 * @throws `std::invalid_argument` if there are no stops, they are out of order, or a channel is out of range
+		 */
+		Gradient(const Space space, std::vector<Stop> stops)
+			: space(space),
+			  stops(std::move(stops))
+		{
+			if (this->stops.empty())
+				throw std::invalid_argument("Gradient: no stops");
+			for (size_t i = 0; i < this->stops.size(); ++i)
 			{
-			case 0:
-				r = v;
-				g = var_3;
-				b = var_1;
-				break;
-			case 1:
-				r = var_2;
-				g = v;
-				b = var_1;
-				break;
-			case 2:
-				r = var_1;
-				g = v;
-				b = var_3;
-				break;
-			case 3:
-				r = var_1;
-				g = var_2;
-				b = v;
-				break;
-			case 4:
-				r = var_3;
-				g = var_1;
-				b = v;
-				break;
-			case 5:
-				r = v;
-				g = var_1;
-				b = var_2;
-				break;
-			default:
-				throw std::logic_error("impossible!!!");
+				auto &stop = this->stops[i];
+				if (stop.position < 0 || stop.position > 1 || (i && stop.position < this->stops[i - 1].position))
+					throw std::invalid_argument("Gradient: stop positions must be nondecreasing and in [0, 1]");
+				const bool hue_free = (space == Space::HSV);
+				if ((!hue_free && (stop.a < 0 || stop.a > 1)) || stop.b < 0 || stop.b > 1 || stop.c < 0 || stop.c > 1)
+					throw std::invalid_argument("Gradient: channels must be in [0, 1]");
+				if (space == Space::RGB)
+					stop = {stop.position, srgb_to_linear(stop.a), srgb_to_linear(stop.b), srgb_to_linear(stop.c)};
 			}
 		}
 
-		return {r * 255, g * 255, b * 255};
-	}
-
-	std::tuple<int, int, int> interpolate(float t, float h1, float s1, float v1, float h2, float s2, float v2)
-	{
-		float h = h1 + t * (h2 - h1);
-		float s = s1 + t * (s2 - s1);
-		float v = v1 + t * (v2 - v1);
+		/**
+		 * Sample the gradient at `n` evenly spaced positions.
+		 * @param n number of entries
+		 * @param cyclic if true, entry `i` is at position `i / n`, for gradients that wrap around like the color wheel.
+		 * otherwise entry `i` is at `i / (n - 1)`, so the first and last entries are the end stops
+		 * @returns packed 0xRRGGBB colors
+		 */
+		std::vector<uint32_t> table(const int n, const bool cyclic = false) const
+		{
+			std::vector<float> a(n), b(n), c(n);
+			const float step = cyclic ? (1.f / n) : (1.f / std::max(n - 1, 1));
+			size_t next = 0;
+			for (int i = 0; i < n; ++i)
+			{
+				// first stop past this position; positions only increase, so this walks the stops once
+				const auto t = i * step;
+				while (next < stops.size() && stops[next].position <= t)
+					++next;
+				const auto &lo = stops[next ? next - 1 : 0], &hi = stops[std::min(next, stops.size() - 1)];
+				const auto span = hi.position - lo.position;
+				const auto f = (span > 0) ? std::clamp((t - lo.position) / span, 0.f, 1.f) : 0.f;
+				a[i] = lo.a + f * (hi.a - lo.a);
+				b[i] = lo.b + f * (hi.b - lo.b);
+				c[i] = lo.c + f * (hi.c - lo.c);
+			}
 
-		return hsvToRgb(h, s, v);
-	}
+			std::vector<uint32_t> rgb(n);
+			if (space == Space::HSV)
+				hsv_to_rgb(a.data(), b.data(), c.data(), rgb.data(), n);
+			else
+				for (int i = 0; i < n; ++i)
+					rgb[i] = pack_rgb(linear_to_srgb(a[i]), linear_to_srgb(b[i]), linear_to_srgb(c[i]));
+			return rgb;
+		}
+	};
 };
\ No newline at end of file
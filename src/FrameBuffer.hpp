@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unistd.h>
+
+/**
+ * Reusable byte buffer that a whole frame is encoded into,
+ * then sent to the terminal with a single `write(2)`.
+ */
+class FrameBuffer
+{
+public:
+	struct Counters
+	{
+		size_t bytes = 0, syscalls = 0;
+	};
+
+private:
+	// only ever grows, so steady-state frames don't allocate
+	std::vector<char> buf;
+	size_t len = 0;
+
+	// counters for the last flushed frame, and for all frames so far
+	Counters last, total;
+	size_t frames = 0;
+
+public:
+	FrameBuffer(const size_t capacity = 1 << 16) : buf(capacity) {}
+
+	void clear() { len = 0; }
+	size_t size() const { return len; }
+	const char *data() const { return buf.data(); }
+	std::string_view view() const { return {buf.data(), len}; }
+
+	void append(const char c)
+	{
+		reserve(1);
+		buf[len++] = c;
+	}
+
+	void append(const char *const s, const size_t n)
+	{
+		reserve(n);
+		memcpy(buf.data() + len, s, n);
+		len += n;
+	}
+
+	void append(const std::string_view s)
+	{
+		append(s.data(), s.size());
+	}
+
+	/**
+	 * Append the decimal representation of `n`, two digits at a time.
+	 * @param n unsigned integer to format
+	 */
+	void append_uint(unsigned n)
+	{
+		static constexpr char digit_pairs[] =
+			"00010203040506070809"
+			"10111213141516171819"
+			"20212223242526272829"
+			"30313233343536373839"
+			"40414243444546474849"
+			"50515253545556575859"
+			"60616263646566676869"
+			"70717273747576777879"
+			"80818283848586878889"
+			"90919293949596979899";
+
+		char tmp[10];
+		char *p = tmp + sizeof(tmp);
+		while (n >= 100)
+		{
+			const auto pair = (n % 100) * 2;
+			n /= 100;
+			*--p = digit_pairs[pair + 1];
+			*--p = digit_pairs[pair];
+		}
+		if (n >= 10)
+		{
+			*--p = digit_pairs[n * 2 + 1];
+			*--p = digit_pairs[n * 2];
+		}
+		else
+			*--p = '0' + n;
+		append(p, tmp + sizeof(tmp) - p);
+	}
+
+	/**
+	 * Write the whole buffer to `fd`, then clear it.
+	 * Normally takes one `write(2)`; only loops on partial writes.
+	 * @param fd file descriptor to write to
+	 * @throws `std::runtime_error` if `write` fails
+	 */
+	void flush(const int fd = STDOUT_FILENO)
+	{
+		last = {};
+		for (size_t written = 0; written < len;)
+		{
+			const auto n = ::write(fd, buf.data() + written, len - written);
+			++last.syscalls;
+			if (n == -1)
+			{
+				if (errno == EINTR || errno == EAGAIN)
+					continue;
+				throw std::runtime_error(std::string("write: ") + strerror(errno));
+			}
+			written += n;
+		}
+		last.bytes = len;
+		total.bytes += last.bytes;
+		total.syscalls += last.syscalls;
+		++frames;
+		clear();
+	}
+
+	const Counters &last_frame() const { return last; }
+	const Counters &all_frames() const { return total; }
+	size_t frames_flushed() const { return frames; }
+
+private:
+	void reserve(const size_t n)
+	{
+		if (len + n > buf.size())
+			buf.resize(std::max(buf.size() * 2, len + n));
+	}
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include "FrameTiming.hpp"
+
+/**
+ * Where playback is, according to the audio device's clock.
+ * The audio callback records which audio frame its buffer starts with and the stream time it will be heard at.
+ * Readers extrapolate from that with the current stream time (`Pa_GetStreamTime`), which is much finer than the
+ * callback's buffer size and accounts for output latency.
+ * A seqlock keeps the pair consistent without blocking the callback.
+ */
+class AudioClock
+{
+	// odd while the callback is writing, 0 before the first update
+	std::atomic<uint32_t> seq = 0;
+	std::atomic<double> dac_time = 0;
+	std::atomic<uint64_t> dac_frame = 0;
+
+public:
+	// audio callback: audio frame `frame` will be heard at stream time `time`
+	void update(const uint64_t frame, const double time)
+	{
+		const auto s = seq.load(std::memory_order_relaxed);
+		seq.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		dac_time.store(time, std::memory_order_relaxed);
+		dac_frame.store(frame, std::memory_order_relaxed);
+		seq.store(s + 2, std::memory_order_release);
+	}
+
+	/**
+	 * @param now current stream time
+	 * @param samplerate audio frames per second
+	 * @returns the audio frame being heard at `now`, or nothing before the first update
+	 */
+	std::optional<int64_t> position(const double now, const int samplerate) const
+	{
+		uint32_t s1, s2;
+		double time;
+		uint64_t frame;
+		do
+		{
+			s1 = seq.load(std::memory_order_acquire);
+			time = dac_time.load(std::memory_order_relaxed);
+			frame = dac_frame.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			s2 = seq.load(std::memory_order_relaxed);
+		} while (s1 != s2 || (s1 & 1));
+
+		if (!s1)
+			return {};
+		return std::max<int64_t>(0, frame + (int64_t)((now - time) * samplerate));
+	}
+};
+
+/**
+ * Decides which video frame to show from the audio position, instead of showing every frame in turn.
+ * If rendering falls behind, the frames that are already stale are dropped (and counted) rather than
+ * shown late, so lag never accumulates.
+ */
+class FrameScheduler
+{
+	FrameTiming timing;
+	int samplerate;
+
+	// last frame shown, -1 before the first one
+	int64_t last = -1;
+	uint64_t dropped = 0;
+
+public:
+	FrameScheduler(const FrameTiming &timing) : timing(timing), samplerate(timing.get_samplerate()) {}
+	FrameScheduler(const int samplerate, const double fps) : FrameScheduler(FrameTiming(samplerate, fps)) {}
+
+	const FrameTiming &get_timing() const { return timing; }
+	int64_t last_frame() const { return last; }
+	uint64_t dropped_frames() const { return dropped; }
+
+	/**
+	 * Take the frame that should be on screen once audio frame `position` is heard.
+	 * @returns that frame, or nothing if it is the one already shown
+	 */
+	std::optional<int64_t> due(const int64_t position)
+	{
+		const auto f = timing.frame_at(position);
+		if (f <= last)
+			return {};
+		if (last >= 0)
+			dropped += f - last - 1;
+		last = f;
+		return f;
+	}
+
+	// seconds from audio frame `position` until the next frame is due
+	double seconds_until_next(const int64_t position) const
+	{
+		return std::max(0., (double)(timing.start(last + 1) - position) / samplerate);
+	}
+};
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Fixed-bucket latency histogram. Buckets are logarithmic with 8 linear sub-buckets per
+ * power of two, so any recorded value is known to within 12.5% without storing samples.
+ */
+class LatencyHistogram
+{
+	static constexpr int SUB_BUCKETS = 8, SUB_BITS = 3;
+
+	// covers up to 2^40 ns (~18 minutes), longer values land in the last bucket
+	static constexpr int MAX_EXPONENT = 40;
+	static constexpr int BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) * SUB_BUCKETS;
+
+	std::array<uint64_t, BUCKETS> counts{};
+	uint64_t count = 0, sum = 0, max = 0;
+
+public:
+	static int bucket_of(const uint64_t ns)
+	{
+		if (ns < SUB_BUCKETS)
+			return ns;
+		const int e = std::bit_width(ns) - 1;
+		if (e > MAX_EXPONENT)
+			return BUCKETS - 1;
+		return (e - SUB_BITS + 1) * SUB_BUCKETS + ((ns >> (e - SUB_BITS)) & (SUB_BUCKETS - 1));
+	}
+
+	// smallest value that lands in `bucket`
+	static uint64_t bucket_floor(const int bucket)
+	{
+		if (bucket < SUB_BUCKETS)
+			return bucket;
+		const int e = bucket / SUB_BUCKETS + SUB_BITS - 1;
+		return (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << (e - SUB_BITS);
+	}
+
+	void record(const uint64_t ns)
+	{
+		++counts[bucket_of(ns)];
+		++count;
+		sum += ns;
+		max = std::max(max, ns);
+	}
+
+	uint64_t get_count() const { return count; }
+	uint64_t get_max() const { return max; }
+	uint64_t mean() const { return count ? (sum / count) : 0; }
+
+	/**
+	 * @param p percentile in [0, 100]
+	 * @returns upper bound of the bucket holding the `p`th percentile, or 0 if nothing was recorded
+	 */
+	uint64_t percentile(const double p) const
+	{
+		if (!count)
+			return 0;
+		const auto rank = std::max<uint64_t>(1, p / 100 * count + 0.5);
+		uint64_t seen = 0;
+		for (int i = 0; i < BUCKETS; ++i)
+			if ((seen += counts[i]) >= rank)
+				return std::min(max, (i + 1 < BUCKETS) ? (bucket_floor(i + 1) - 1) : max);
+		return max;
+	}
+
+	// (bucket floor, count) of every nonempty bucket
+	std::vector<std::pair<uint64_t, uint64_t>> nonempty_buckets() const
+	{
+		std::vector<std::pair<uint64_t, uint64_t>> buckets;
+		for (int i = 0; i < BUCKETS; ++i)
+			if (counts[i])
+				buckets.emplace_back(bucket_floor(i), counts[i]);
+		return buckets;
+	}
+};
+
+/**
+ * Per-stage frame timing. Every stage of the frame pipeline is timed with the monotonic clock
+ * and recorded into its own `LatencyHistogram`.
+ * Code under measurement holds a `FrameStats *` that is null when stats are disabled,
+ * in which case a `Timer` costs a single branch.
+ */
+class FrameStats
+{
+public:
+	enum Stage
+	{
+		DECODE,
+		AUDIO,
+		COPY,
+		WINDOW,
+		FFT,
+		BINS,
+		INTERP,
+		DRAW,
+		ENCODE,
+		WRITE,
+		FRAME,
+		STAGE_COUNT
+	};
+
+	static constexpr const char *stage_names[STAGE_COUNT]{
+		"decode", "audio", "copy", "window", "fft", "bins", "interp", "draw", "encode", "write", "frame"};
+
+	using Clock = std::chrono::steady_clock;
+
+	// times its own lifetime into `stage` of `stats`, if `stats` isn't null
+	class Timer
+	{
+		FrameStats *const stats;
+		const Stage stage;
+		Clock::time_point start;
+
+	public:
+		Timer(FrameStats *const stats, const Stage stage) : stats(stats), stage(stage)
+		{
+			if (stats)
+				start = Clock::now();
+		}
+
+		~Timer()
+		{
+			if (stats)
+				stats->record(stage, Clock::now() - start);
+		}
+
+		Timer(const Timer &) = delete;
+		Timer &operator=(const Timer &) = delete;
+	};
+
+private:
+	std::array<LatencyHistogram, STAGE_COUNT> histograms;
+
+public:
+	void record(const Stage stage, const Clock::duration d)
+	{
+		histograms[stage].record(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+	}
+
+	const LatencyHistogram &operator[](const Stage stage) const { return histograms[stage]; }
+
+	/**
+	 * One line summary for an on-screen overlay: p50/p99/max of the whole frame, then each stage's p50.
+	 */
+	std::string overlay() const
+	{
+		const auto &frame = histograms[FRAME];
+		char buf[64];
+		snprintf(buf, sizeof(buf), "frame p50 %.2fms p99 %.2fms max %.2fms |",
+				 frame.percentile(50) / 1e6, frame.percentile(99) / 1e6, frame.get_max() / 1e6);
+		std::string line = buf;
+		for (int s = 0; s < FRAME; ++s)
+		{
+			if (!histograms[s].get_count())
+				continue;
+			snprintf(buf, sizeof(buf), " %s %.0f", stage_names[s], histograms[s].percentile(50) / 1e3);
+			line += buf;
+		}
+		return line + " (us p50)";
+	}
+
+	// human readable table of every stage that was recorded
+	void print_summary(std::ostream &os) const
+	{
+		char buf[128];
+		snprintf(buf, sizeof(buf), "%-8s %8s %10s %10s %10s %10s\n", "stage", "count", "mean us", "p50 us", "p99 us", "max us");
+		os << buf;
+		for (int s = 0; s < STAGE_COUNT; ++s)
+		{
+			const auto &h = histograms[s];
+			if (!h.get_count())
+				continue;
+			snprintf(buf, sizeof(buf), "%-8s %8lu %10.1f %10.1f %10.1f %10.1f\n", stage_names[s], (unsigned long)h.get_count(),
+					 h.mean() / 1e3, h.percentile(50) / 1e3, h.percentile(99) / 1e3, h.get_max() / 1e3);
+			os << buf;
+		}
+	}
+
+	/**
+	 * Dump every stage's summary and nonempty histogram buckets as a JSON object.
+	 * @param extra additional top-level numeric fields, e.g. output byte counts
+	 */
+	void write_json(std::ostream &os, const std::vector<std::pair<std::string, double>> &extra = {}) const
+	{
+		os << '{';
+		for (const auto &[key, value] : extra)
+			os << '"' << key << "\":" << value << ',';
+		os << "\"stages\":{";
+		bool first = true;
+		for (int s = 0; s < STAGE_COUNT; ++s)
+		{
+			const auto &h = histograms[s];
+			if (!h.get_count())
+				continue;
+			if (!first)
+				os << ',';
+			first = false;
+			os << '"' << stage_names[s] << "\":{\"count\":" << h.get_count()
+			   << ",\"mean_ns\":" << h.mean()
+			   << ",\"p50_ns\":" << h.percentile(50)
+			   << ",\"p99_ns\":" << h.percentile(99)
+			   << ",\"max_ns\":" << h.get_max()
+			   << ",\"buckets\":[";
+			bool first_bucket = true;
+			for (const auto &[floor, count] : h.nonempty_buckets())
+			{
+				if (!first_bucket)
+					os << ',';
+				first_bucket = false;
+				os << '[' << floor << ',' << count << ']';
+			}
+			os << "]}";
+		}
+		os << "}}\n";
+	}
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Maps video frames to audio frames at a possibly fractional frame rate, without drift.
+ * The hop between video frames is kept as an exact fraction of audio frames, either from a frame rate
+ * or given directly, independent of the analysis window. Video frame `f` starts at audio frame `floor(f * hop)`,
+ * computed exactly with integers, so hops alternate between neighbouring lengths instead of rounding the same way
+ * every frame (e.g. 44.1 kHz at 144 fps is 306.25 audio frames per video frame).
+ */
+class FrameTiming
+{
+	// frame rates are kept to thousandths, e.g. 59.94 is 59940 / 1000
+	static constexpr int64_t fps_den = 1000;
+
+	// audio frames per video frame: samplerate * 1000 / (fps * 1000) from a frame rate, or hop / 1
+	int64_t samplerate, hop_num, hop_den;
+
+public:
+	/**
+	 * @param samplerate audio frames per second
+	 * @param fps video frames per second, kept to 3 decimals
+	 * @throws `std::invalid_argument` if either isn't positive
+	 */
+	FrameTiming(const int samplerate, const double fps)
+		: samplerate(samplerate),
+		  hop_num((int64_t)samplerate * fps_den),
+		  hop_den(std::llround(fps * fps_den))
+	{
+		if (samplerate <= 0 || hop_den <= 0)
+			throw std::invalid_argument("FrameTiming: samplerate and fps must be positive");
+	}
+
+	/**
+	 * @param samplerate audio frames per second
+	 * @param hop audio frames between the starts of consecutive video frames
+	 * @throws `std::invalid_argument` if either isn't positive
+	 */
+	static FrameTiming from_hop(const int samplerate, const int hop)
+	{
+		if (hop <= 0)
+			throw std::invalid_argument("FrameTiming: hop must be positive");
+		FrameTiming timing(samplerate, 1.);
+		timing.hop_num = hop;
+		timing.hop_den = 1;
+		return timing;
+	}
+
+	int get_samplerate() const { return samplerate; }
+
+	double fps() const { return (double)samplerate * hop_den / hop_num; }
+
+	// audio frame at which video frame `f` starts
+	int64_t start(const int64_t f) const
+	{
+		return f * hop_num / hop_den;
+	}
+
+	// the video frame playing at audio frame `sample`: the last one that starts at or before it
+	int64_t frame_at(const int64_t sample) const
+	{
+		return ((sample + 1) * hop_den - 1) / hop_num;
+	}
+
+	// number of video frames needed to cover `samples` audio frames, counting a final partial one
+	int64_t frames_in(const int64_t samples) const
+	{
+		return samples ? (frame_at(samples - 1) + 1) : 0;
+	}
+
+	// longest hop between two video frames
+	int max_hop() const
+	{
+		return (hop_num + hop_den - 1) / hop_den;
+	}
+
+	// for keying caches of per-frame data
+	std::string key() const
+	{
+		if (hop_num != samplerate * fps_den)
+			return "sr=" + std::to_string(samplerate) + " hop=" + std::to_string(hop_num) + "/" + std::to_string(hop_den);
+		return "sr=" + std::to_string(samplerate) + " fps=" + std::to_string(hop_den) + "/" + std::to_string(fps_den);
+	}
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <sndfile.hh>
+#include "FrameTiming.hpp"
+#include "FrequencySpectrum.hpp"
+
+/**
+ * Reads the analysis windows of video frames straight from an audio file, for when frames are
+ * rendered out of playback order. Video frame `f` analyses the `sample_size` samples ending where
+ * the next video frame starts, which is what playback has just played when it shows frame `f`.
+ * Samples before the start or past the end of the file read as silence.
+ */
+class FrameWindows
+{
+	SndfileHandle sf;
+	int channels, sample_size;
+	FrameTiming timing;
+	sf_count_t total_samples;
+
+	// interleaved samples covering the windows of the loaded frames, starting at sample `begin`
+	std::vector<float> samples;
+	sf_count_t begin = 0;
+
+public:
+	/**
+	 * @param timing when each video frame starts, at the file's sample rate
+	 */
+	FrameWindows(const std::string &audio_file, const int sample_size, const FrameTiming &timing)
+		: sf(audio_file),
+		  channels(sf.channels()),
+		  sample_size(sample_size),
+		  timing(timing),
+		  total_samples(sf.frames())
+	{
+	}
+
+	int get_channels() const { return channels; }
+	int samplerate() const { return sf.samplerate(); }
+
+	const FrameTiming &get_timing() const { return timing; }
+
+	// number of video frames in the file, counting a final partial one
+	long frames() const { return timing.frames_in(total_samples); }
+
+	/**
+	 * Read every sample the windows of video frames [first, last) cover, with a single seek.
+	 */
+	void load(const long first, const long last)
+	{
+		begin = timing.start(first + 1) - sample_size;
+		const sf_count_t end = timing.start(last);
+		const sf_count_t skipped = std::max<sf_count_t>(0, -begin);
+		samples.assign((end - begin) * channels, 0);
+		if (const auto to_read = std::min(end, total_samples) - begin - skipped; to_read > 0)
+		{
+			sf.seek(begin + skipped, SEEK_SET);
+			sf.readf(samples.data() + skipped * channels, to_read);
+		}
+	}
+
+	/**
+	 * Copy the window of video frame `f`, which must have been loaded, into every input channel of `fs`.
+	 * Like playback, if the file has fewer channels than `fs`, its last channel is used instead.
+	 */
+	void copy_to(const long f, FrequencySpectrum &fs) const
+	{
+		const auto window = samples.data() + (timing.start(f + 1) - sample_size - begin) * channels;
+		for (int ch = 0; ch < fs.get_channels(); ++ch)
+		{
+			const int src = std::min(ch, channels - 1);
+			float *const in = fs.input_array(ch);
+			for (int i = 0; i < sample_size; ++i)
+				in[i] = window[i * channels + src];
+		}
+	}
+};
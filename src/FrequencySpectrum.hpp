@@ -1,8 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <span>
 #include <stdexcept>
+#include <string>
 #include <vector>
-#include "spline.hpp"
+#include "FrameStats.hpp"
+#include "Interpolator.hpp"
+#include "SpectrumKernels.hpp"
 #include "fftwf_dft_r2c_1d.hpp"
 
 class FrequencySpectrum
@@ -18,9 +25,9 @@ public:
 	enum class InterpType
 	{
 		NONE,
-		LINEAR = tk::spline::linear,
-		CSPLINE = tk::spline::cspline,
-		CSPLINE_HERMITE = tk::spline::cspline_hermite
+		LINEAR = Interpolator::LINEAR,
+		CSPLINE = Interpolator::CSPLINE,
+		CSPLINE_HERMITE = Interpolator::CSPLINE_HERMITE
 	};
 
 	enum class AccumulationMethod
@@ -34,7 +41,19 @@ public:
 		NONE,
 		HANNING,
 		HAMMING,
-		BLACKMAN
+		BLACKMAN,
+		BLACKMAN_HARRIS,
+		NUTTALL,
+		FLATTOP,
+		KAISER
+	};
+
+	enum class PlannerRigor
+	{
+		ESTIMATE = FFTW_ESTIMATE,
+		MEASURE = FFTW_MEASURE,
+		PATIENT = FFTW_PATIENT,
+		EXHAUSTIVE = FFTW_EXHAUSTIVE
 	};
 
 private:
@@ -50,7 +69,7 @@ private:
 	fftwf_dft_r2c_1d fftw = fftwf_dft_r2c_1d(fft_size);
 
 	// interpolation
-	tk::spline spline;
+	Interpolator interpolator;
 	InterpType interp = InterpType::CSPLINE;
 
 	// output spectrum scale
@@ -62,6 +81,15 @@ private:
 	// window function
 	WindowFunction wf = WindowFunction::BLACKMAN;
 
+	// shape parameter for `WindowFunction::KAISER`
+	float kaiser_beta = 8.6;
+
+	// window coefficients for the current `fft_size` and `wf`, empty for `WindowFunction::NONE`
+	std::vector<float> window;
+
+	// set by `load_windowed`: the input already has the window applied, so the next `render` doesn't
+	bool input_windowed = false;
+
 	// struct to hold the "max"s used in `calc_index_ratio`
 	struct
 	{
@@ -77,6 +105,29 @@ private:
 		}
 	} scale_max;
 
+	// for each spectrum column, the contiguous range of fft bins that accumulate into it.
+	// depends only on the fft size, spectrum width, scale and nth root, so it is rebuilt
+	// only when one of those changes instead of calling `calc_index` per bin per frame.
+	struct
+	{
+		// column `c` accumulates bins [offsets[c], offsets[c + 1])
+		std::vector<int> offsets;
+		int width = 0;
+		bool dirty = true;
+
+		int first_bin(const int c) const { return offsets[c]; }
+		int last_bin(const int c) const { return offsets[c + 1]; }
+	} bin_map;
+
+	// amplitude of every fft bin, filled before being reduced into the spectrum columns
+	std::vector<float> magnitudes;
+
+	// magnitude and column reduction loops for the widest instruction set available
+	const SpectrumKernels::Kernels *kernels = &SpectrumKernels::best();
+
+	// stage timings of `render`, null when not collecting stats
+	FrameStats *stats = nullptr;
+
 public:
 	/**
 	 * Initialize frequency spectrum renderer.
@@ -85,6 +136,7 @@ public:
 	FrequencySpectrum(const int fft_size) : fft_size(fft_size)
 	{
 		scale_max.set(*this);
+		build_window();
 	}
 
 	/**
@@ -95,9 +147,26 @@ public:
 	 */
 	FrequencySpectrum &set_fft_size(const int fft_size)
 	{
+		this->fft_size = fft_size;
 		fftw.set_n(fft_size);
 		fftsize_inv = 1. / fft_size;
 		scale_max.set(*this);
+		build_window();
+		bin_map.dirty = true;
+		return *this;
+	}
+
+	/**
+	 * Set how hard fftw should look for a fast plan.
+	 * Anything above `ESTIMATE` benchmarks candidate plans, which is slow the first time for a given size
+	 * unless the plan is found in fftw's wisdom (see `fftwf_dft_r2c_1d::wisdom_file`).
+	 * @note Re-plans immediately, overwriting `input_array()`.
+	 * @param rigor new planner rigor to use
+	 * @returns reference to self
+	 */
+	FrequencySpectrum &set_planner_rigor(const PlannerRigor rigor)
+	{
+		fftw.set_flags((unsigned)rigor);
 		return *this;
 	}
 
@@ -120,6 +189,24 @@ public:
 	FrequencySpectrum &set_window_func(const WindowFunction wf)
 	{
 		this->wf = wf;
+		build_window();
+		return *this;
+	}
+
+	/**
+	 * Set the beta (shape) parameter of the Kaiser window.
+	 * Higher values trade a wider main lobe for lower side lobes.
+	 * @param beta new beta to use
+	 * @returns reference to self
+	 * @throws `std::invalid_argument` if `beta` is negative
+	 */
+	FrequencySpectrum &set_kaiser_beta(const float beta)
+	{
+		if (beta < 0)
+			throw std::invalid_argument("FrequencySpectrum::set_kaiser_beta: beta cannot be negative!");
+		kaiser_beta = beta;
+		if (wf == WindowFunction::KAISER)
+			build_window();
 		return *this;
 	}
 
@@ -142,6 +229,7 @@ public:
 	FrequencySpectrum &set_scale(const Scale scale)
 	{
 		this->scale = scale;
+		bin_map.dirty = true;
 		return *this;
 	}
 
@@ -149,95 +237,281 @@ public:
 	 * Set the nth-root to use when using the `NTH_ROOT` scale.
 	 * @param nth_root new nth_root to use
 	 * @returns reference to self
-	 * @throws `std::invalid_argument` if `nth_root` is zero
+	 * @throws `std::invalid_argument` if `nth_root` is less than 1, which would not map bins to columns in increasing order
 	 */
 	FrequencySpectrum &set_nth_root(const int nth_root)
 	{
-		if (!nth_root)
-			throw std::invalid_argument("FrequencySpectrun::set_nth_root: nth_root cannot be zero!");
+		if (nth_root < 1)
+			throw std::invalid_argument("FrequencySpectrum::set_nth_root: nth_root must be at least 1!");
 		this->nth_root = nth_root;
 		nth_root_inverse = 1.f / nth_root;
+		scale_max.set(*this);
+		bin_map.dirty = true;
 		return *this;
 	}
 
-	float *input_array()
+	/**
+	 * Force the instruction set used by the magnitude and reduction kernels, instead of the widest available.
+	 * All instruction sets produce identical spectra, so this is only useful for comparing them.
+	 * @param isa instruction set to use
+	 * @returns reference to self
+	 * @throws `std::invalid_argument` if `isa` isn't supported on this cpu
+	 */
+	FrequencySpectrum &set_kernel_isa(const SpectrumKernels::Isa isa)
 	{
-		return fftw.get_input();
+		kernels = &SpectrumKernels::get(isa);
+		return *this;
+	}
+
+	/**
+	 * Record the time `render` spends windowing, transforming, mapping bins and interpolating.
+	 * @param stats stats to record into, or null to stop recording
+	 * @returns reference to self
+	 */
+	FrequencySpectrum &set_stats(FrameStats *const stats)
+	{
+		this->stats = stats;
+		return *this;
+	}
+
+	/**
+	 * Set the number of channels transformed together by `render`.
+	 * All channels are windowed and transformed in a single batched fft.
+	 * @param channels new channel count to use
+	 * @returns reference to self
+	 * @throws `std::invalid_argument` if `channels` is less than 1
+	 */
+	FrequencySpectrum &set_channels(const int channels)
+	{
+		if (channels < 1)
+			throw std::invalid_argument("FrequencySpectrum::set_channels: channels must be at least 1!");
+		fftw.set_howmany(channels);
+		return *this;
+	}
+
+	int get_channels() const
+	{
+		return fftw.get_howmany();
+	}
+
+	/**
+	 * @returns every setting that affects what `render` outputs for a given input and spectrum width,
+	 * as a string, for keying caches of rendered spectra
+	 */
+	std::string settings_key() const
+	{
+		std::string key = "n=" + std::to_string(fft_size) +
+						  " ch=" + std::to_string(get_channels()) +
+						  " window=" + std::to_string((int)wf) +
+						  " scale=" + std::to_string((int)scale) +
+						  " accum=" + std::to_string((int)am) +
+						  " interp=" + std::to_string((int)interp);
+		if (wf == WindowFunction::KAISER)
+			key += " beta=" + std::to_string(kaiser_beta);
+		if (scale == Scale::NTH_ROOT)
+			key += " root=" + std::to_string(nth_root);
+		return key;
+	}
+
+	/**
+	 * @param channel zero-based channel index
+	 * @returns the `fft_size` long input array of `channel`
+	 */
+	float *input_array(const int channel = 0)
+	{
+		return fftw.get_input() + channel * fft_size;
+	}
+
+	/**
+	 * Write `fft_size` samples to the input array of `channel`, applying the window on the way,
+	 * instead of copying them to `input_array(channel)` and having `render` window them in a second pass.
+	 * Load either every channel this way before the next `render`, or none.
+	 * @param channel zero-based channel index
+	 * @param samples `fft_size` samples, left untouched
+	 */
+	void load_windowed(const int channel, const float *const samples)
+	{
+		float *const in = input_array(channel);
+		if (window.empty())
+			std::copy(samples, samples + fft_size, in);
+		else
+		{
+			const float *const w = window.data();
+			for (int i = 0; i < fft_size; ++i)
+				in[i] = samples[i] * w[i];
+		}
+		input_windowed = true;
 	}
 
 	// it is assumed that `input_array()` holds your input wave data!
 	// you must write your input data to `input_array()` before calling `render`!!!!!!!!
 	void render(std::vector<float> &spectrum)
 	{
-		apply_window_func(input_array());
-		fftw.execute();
+		render(std::span(&spectrum, 1));
+	}
 
-		// zero out array since we are accumulating
-		std::ranges::fill(spectrum, 0);
+	/**
+	 * Render every channel's spectrum with a single batched fft.
+	 * Write each channel's input to `input_array(channel)` first.
+	 * @param spectra one output spectrum per channel, all of the same size
+	 * @throws `std::invalid_argument` if there isn't one spectrum per channel
+	 */
+	void render(const std::span<std::vector<float>> spectra)
+	{
+		if ((int)spectra.size() != get_channels())
+			throw std::invalid_argument("FrequencySpectrum::render: need one spectrum per channel");
 
-		const auto output = fftw.get_output();
+		{
+			const FrameStats::Timer t(stats, FrameStats::WINDOW);
+			if (!input_windowed)
+				apply_window_func();
+			input_windowed = false;
+		}
+		{
+			const FrameStats::Timer t(stats, FrameStats::FFT);
+			fftw.execute();
+		}
 
-		// map frequency bins of freqdata to spectrum
-		for (int i = 0; i < fftw.get_output_size(); ++i)
 		{
-			const auto [re, im] = output[i];
-			const float amplitude = sqrt((re * re) + (im * im));
-			const auto index = calc_index(i, spectrum.size());
+			const FrameStats::Timer t(stats, FrameStats::BINS);
+
+			if (bin_map.dirty || bin_map.width != (int)spectra[0].size())
+				build_bin_map(spectra[0].size());
 
-			switch (am)
+			const auto output_size = fftw.get_output_size();
+			magnitudes.resize(output_size);
+
+			for (int ch = 0; ch < (int)spectra.size(); ++ch)
 			{
-			case AccumulationMethod::SUM:
-				spectrum[index] += amplitude;
-				break;
-			
-			case AccumulationMethod::MAX:
-				spectrum[index] = std::max(spectrum[index], amplitude);
-				break;
-			
-			default:
-				throw std::logic_error("FrequencySpectrum::render: switch(accum_type): default case hit");
+				auto &spectrum = spectra[ch];
+				kernels->magnitudes(fftw.get_output() + ch * output_size, magnitudes.data(), output_size);
+
+				// reduce each column's contiguous bin range.
+				// columns with an empty range are left at zero, which `interpolate` relies on.
+				switch (am)
+				{
+				case AccumulationMethod::SUM:
+					kernels->reduce_sum(magnitudes.data(), bin_map.offsets.data(), spectrum.data(), bin_map.width);
+					break;
+
+				case AccumulationMethod::MAX:
+					kernels->reduce_max(magnitudes.data(), bin_map.offsets.data(), spectrum.data(), bin_map.width);
+					break;
+
+				default:
+					throw std::logic_error("FrequencySpectrum::render: switch(accum_type): default case hit");
+				}
+
+				// downscale all amplitudes by 1 / fft_size
+				// this is because with smaller fft_size's, frequency bins are bigger
+				// so more frequencies get lumped together, causing higher amplitudes per bin.
+				for (auto &a : spectrum)
+					a *= fftsize_inv;
 			}
 		}
 
-		// downscale all amplitudes by 1 / fft_size
-		// this is because with smaller fft_size's, frequency bins are bigger
-		// so more frequencies get lumped together, causing higher amplitudes per bin.
-		for (auto &a : spectrum)
-			a *= fftsize_inv;
-
 		// apply interpolation if necessary
 		if (interp != InterpType::NONE && scale != Scale::LINEAR)
-			interpolate(spectrum);
+		{
+			const FrameStats::Timer t(stats, FrameStats::INTERP);
+			for (auto &spectrum : spectra)
+				interpolate(spectrum);
+		}
 	}
 
 private:
-	void apply_window_func(float *const timedata)
+	// window every channel of the batch in one pass over the channel-major input
+	void apply_window_func()
 	{
-		switch (wf)
+		if (window.empty())
+			return;
+
+		// plain elementwise multiply, left for the compiler to vectorize
+		const float *const w = window.data();
+		for (int ch = 0; ch < get_channels(); ++ch)
 		{
-		case WindowFunction::HANNING:
+			float *const timedata = input_array(ch);
 			for (int i = 0; i < fft_size; ++i)
-				timedata[i] *= 0.5f * (1 - cos(2 * M_PI * i / (fft_size - 1)));
-			break;
+				timedata[i] *= w[i];
+		}
+	}
 
+	// recompute `window` for the current `fft_size` and `wf`.
+	// only called when either of them changes, so the trig here never runs per frame.
+	void build_window()
+	{
+		switch (wf)
+		{
+		case WindowFunction::NONE:
+			window.clear();
+			return;
+		case WindowFunction::HANNING:
+			cosine_sum_window({0.5, 0.5});
+			return;
 		case WindowFunction::HAMMING:
-			for (int i = 0; i < fft_size; ++i)
-				timedata[i] *= 0.54f - 0.46f * cos(2 * M_PI * i / (fft_size - 1));
-			break;
-
+			cosine_sum_window({0.54, 0.46});
+			return;
 		case WindowFunction::BLACKMAN:
+			cosine_sum_window({0.42, 0.5, 0.08});
+			return;
+		case WindowFunction::BLACKMAN_HARRIS:
+			cosine_sum_window({0.35875, 0.48829, 0.14128, 0.01168});
+			return;
+		case WindowFunction::NUTTALL:
+			cosine_sum_window({0.355768, 0.487396, 0.144232, 0.012604});
+			return;
+		case WindowFunction::FLATTOP:
+			cosine_sum_window({0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368});
+			return;
+		case WindowFunction::KAISER:
+		{
+			window.resize(fft_size);
+			const double i0_beta = std::cyl_bessel_i(0., kaiser_beta);
 			for (int i = 0; i < fft_size; ++i)
-				timedata[i] *= 0.42f - 0.5f * cos(2 * M_PI * i / (fft_size - 1)) + 0.08f * cos(4 * M_PI * i / (fft_size - 1));
-			break;
-
-		case WindowFunction::NONE:
-			break;
-
+			{
+				const double r = 2. * i / (fft_size - 1) - 1;
+				window[i] = std::cyl_bessel_i(0., kaiser_beta * std::sqrt(1 - r * r)) / i0_beta;
+			}
+			return;
+		}
 		default:
-			throw std::logic_error("FrequencySpectrum::apply_window_func: default case hit");
+			throw std::logic_error("FrequencySpectrum::build_window: default case hit");
+		}
+	}
+
+	// w[i] = a0 - a1*cos(2*pi*i/(N-1)) + a2*cos(4*pi*i/(N-1)) - ...
+	void cosine_sum_window(const std::initializer_list<double> coeffs)
+	{
+		window.resize(fft_size);
+		for (int i = 0; i < fft_size; ++i)
+		{
+			double w = 0, sign = 1;
+			int k = 0;
+			for (const auto a : coeffs)
+			{
+				w += sign * a * cos(2 * M_PI * k * i / (fft_size - 1));
+				sign = -sign;
+				++k;
+			}
+			window[i] = w;
 		}
 	}
 
+	// `calc_index` is monotonic in the bin index, so every column maps to a contiguous range of bins
+	void build_bin_map(const int width)
+	{
+		bin_map.width = width;
+		bin_map.offsets.assign(width + 1, 0);
+
+		// count bins per column, then prefix-sum into range offsets
+		for (int i = 0; i < fftw.get_output_size(); ++i)
+			++bin_map.offsets[calc_index(i, width) + 1];
+		for (int c = 0; c < width; ++c)
+			bin_map.offsets[c + 1] += bin_map.offsets[c];
+
+		bin_map.dirty = false;
+	}
+
 	int calc_index(const int i, const int max_index)
 	{
 		return std::max(0, std::min((int)(calc_index_ratio(i) * max_index), max_index - 1));
@@ -272,25 +546,6 @@ private:
 
 	void interpolate(std::vector<float> &spectrum)
 	{
-		// separate the nonzero values (y's) and their indices (x's)
-		std::vector<double> nonzero_values, indices;
-		for (int i = 0; i < (int)spectrum.size(); ++i)
-		{
-			if (!spectrum[i])
-				continue;
-			nonzero_values.push_back(spectrum[i]);
-			indices.push_back(i);
-		}
-
-		// tk::spline::set_points throws if there are less than 3 points
-		// plus, if there are less than 3 points, we wouldn't be smoothing anything
-		if (indices.size() < 3)
-			return;
-
-		spline.set_points(indices, nonzero_values, (tk::spline::spline_type)interp);
-
-		// only copy spline values to fill in the gaps
-		for (int i = 0; i < (int)spectrum.size(); ++i)
-			spectrum[i] = spectrum[i] ? spectrum[i] : spline(i);
+		interpolator.interpolate(spectrum, (Interpolator::Type)interp);
 	}
 };
\ No newline at end of file
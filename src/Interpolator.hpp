@@ -0,0 +1,243 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+
+/**
+ * Fills the zero-valued gaps of a spectrum by interpolating between its nonzero columns (the knots).
+ * Produces the same curves as natural-boundary `tk::spline`, but all workspaces are preallocated floats,
+ * and everything that depends only on the knot positions (including the LU factorization of the cubic
+ * spline system) is cached until the knots move. Since the knots come from the bin map they rarely do,
+ * so a frame usually costs just a forward/back substitution plus evaluation.
+ */
+class Interpolator
+{
+public:
+	enum Type
+	{
+		LINEAR = 1,
+		CSPLINE,
+		CSPLINE_HERMITE
+	};
+
+private:
+	// knot positions the cached coefficients were computed for
+	std::vector<int> x;
+
+	// knot values for the current frame
+	std::vector<float> y;
+
+	// cached per knot layout: segment widths, the forward elimination multipliers and
+	// reciprocal pivots of the cubic spline's tridiagonal system, and hermite finite difference weights
+	std::vector<float> h, elim, pivot_inv, w_prev, w_cur, w_next;
+
+	// per-frame workspaces: f(x) = y[i] + b[i]*t + c[i]*t^2 + d[i]*t^3, where t = x - x[i]
+	std::vector<float> b, c, d;
+
+	Type cached_type = LINEAR;
+	bool layout_valid = false;
+
+public:
+	/**
+	 * Replace the zero-valued entries of `spectrum` with interpolated values.
+	 * Does nothing if there are less than 3 nonzero entries.
+	 * @param spectrum spectrum to fill in
+	 * @param type interpolation type to use
+	 */
+	void interpolate(std::vector<float> &spectrum, const Type type)
+	{
+		const bool knots_moved = collect_knots(spectrum);
+
+		// with less than 3 points we wouldn't be smoothing anything
+		if (x.size() < 3)
+		{
+			layout_valid = false;
+			return;
+		}
+
+		if (knots_moved || type != cached_type || !layout_valid)
+			build_layout(type);
+
+		switch (type)
+		{
+		case LINEAR:
+			solve_linear();
+			break;
+		case CSPLINE:
+			solve_cspline();
+			break;
+		case CSPLINE_HERMITE:
+			solve_hermite();
+			break;
+		default:
+			throw std::logic_error("Interpolator::interpolate: default case hit");
+		}
+
+		evaluate(spectrum);
+	}
+
+private:
+	// gather the nonzero entries into `x`/`y`, returns whether the knot positions changed
+	bool collect_knots(const std::vector<float> &spectrum)
+	{
+		bool changed = false;
+		size_t n = 0;
+		y.clear();
+		for (int i = 0; i < (int)spectrum.size(); ++i)
+		{
+			if (!spectrum[i])
+				continue;
+			if (n == x.size())
+			{
+				x.push_back(i);
+				changed = true;
+			}
+			else if (x[n] != i)
+			{
+				x[n] = i;
+				changed = true;
+			}
+			y.push_back(spectrum[i]);
+			++n;
+		}
+		if (n != x.size())
+		{
+			x.resize(n);
+			changed = true;
+		}
+		return changed;
+	}
+
+	void build_layout(const Type type)
+	{
+		const int n = x.size();
+		h.resize(n - 1);
+		for (int i = 0; i < n - 1; ++i)
+			h[i] = x[i + 1] - x[i];
+
+		b.resize(n);
+		c.resize(n);
+		d.resize(n);
+
+		if (type == CSPLINE)
+		{
+			// natural boundaries force c[0] = c[n-1] = 0, leaving a tridiagonal system for c[1..n-2]:
+			//   h[i-1]/3 * c[i-1] + 2(h[i-1] + h[i])/3 * c[i] + h[i]/3 * c[i+1] = rhs[i]
+			// factorize it once here (Thomas algorithm), the per-frame solve only needs the right hand side.
+			elim.assign(n, 0);
+			pivot_inv.assign(n, 0);
+			float prev_pivot = 0;
+			for (int i = 1; i < n - 1; ++i)
+			{
+				const float sub = (i > 1) ? h[i - 1] / 3 : 0;
+				const float diag = 2 * (h[i - 1] + h[i]) / 3;
+				elim[i] = (i > 1) ? sub / prev_pivot : 0;
+				prev_pivot = diag - elim[i] * (h[i - 1] / 3);
+				pivot_inv[i] = 1 / prev_pivot;
+			}
+		}
+		else if (type == CSPLINE_HERMITE)
+		{
+			// 3-point finite difference weights for the derivative at each interior knot
+			w_prev.assign(n, 0);
+			w_cur.assign(n, 0);
+			w_next.assign(n, 0);
+			for (int i = 1; i < n - 1; ++i)
+			{
+				const float hr = h[i], hl = h[i - 1];
+				w_prev[i] = -hr / (hl * (hl + hr));
+				w_cur[i] = (hr - hl) / (hl * hr);
+				w_next[i] = hl / (hr * (hl + hr));
+			}
+		}
+
+		cached_type = type;
+		layout_valid = true;
+	}
+
+	void solve_linear()
+	{
+		const int n = x.size();
+		for (int i = 0; i < n - 1; ++i)
+		{
+			b[i] = (y[i + 1] - y[i]) / h[i];
+			c[i] = d[i] = 0;
+		}
+		b[n - 1] = b[n - 2];
+		c[n - 1] = d[n - 1] = 0;
+	}
+
+	void solve_cspline()
+	{
+		const int n = x.size();
+
+		// forward substitution of the right hand side
+		c[0] = 0;
+		for (int i = 1; i < n - 1; ++i)
+		{
+			const float rhs = (y[i + 1] - y[i]) / h[i] - (y[i] - y[i - 1]) / h[i - 1];
+			c[i] = rhs - elim[i] * c[i - 1];
+		}
+
+		// back substitution
+		c[n - 1] = 0;
+		for (int i = n - 2; i >= 1; --i)
+			c[i] = (c[i] - (h[i] / 3) * c[i + 1]) * pivot_inv[i];
+
+		for (int i = 0; i < n - 1; ++i)
+		{
+			d[i] = (c[i + 1] - c[i]) / (3 * h[i]);
+			b[i] = (y[i + 1] - y[i]) / h[i] - (2 * c[i] + c[i + 1]) * h[i] / 3;
+		}
+
+		// linear extrapolation to the right, with the slope at the last knot
+		const float hl = h[n - 2];
+		b[n - 1] = (3 * d[n - 2] * hl + 2 * c[n - 2]) * hl + b[n - 2];
+		d[n - 1] = 0;
+	}
+
+	void solve_hermite()
+	{
+		const int n = x.size();
+		for (int i = 1; i < n - 1; ++i)
+			b[i] = w_prev[i] * y[i - 1] + w_cur[i] * y[i] + w_next[i] * y[i + 1];
+
+		// zero second derivative at both ends
+		b[0] = 0.5f * (-b[1] + 3 * (y[1] - y[0]) / h[0]);
+		b[n - 1] = 0.5f * (-b[n - 2] + 3 * (y[n - 1] - y[n - 2]) / h[n - 2]);
+		c[n - 1] = d[n - 1] = 0;
+
+		for (int i = 0; i < n - 1; ++i)
+		{
+			c[i] = (3 * (y[i + 1] - y[i]) / h[i] - (2 * b[i] + b[i + 1])) / h[i];
+			d[i] = ((b[i + 1] - b[i]) / (3 * h[i]) - 2.f / 3 * c[i]) / h[i];
+		}
+	}
+
+	// fill the gaps, walking the segments in order instead of searching for each column's segment
+	void evaluate(std::vector<float> &spectrum) const
+	{
+		const int n = x.size();
+
+		// extrapolation to the left: quadratic with the first segment's c
+		for (int i = 0; i < x[0]; ++i)
+		{
+			const float t = i - x[0];
+			spectrum[i] = (c[0] * t + b[0]) * t + y[0];
+		}
+
+		for (int k = 0; k < n - 1; ++k)
+			for (int i = x[k] + 1; i < x[k + 1]; ++i)
+			{
+				const float t = i - x[k];
+				spectrum[i] = ((d[k] * t + c[k]) * t + b[k]) * t + y[k];
+			}
+
+		// extrapolation to the right
+		for (int i = x[n - 1] + 1; i < (int)spectrum.size(); ++i)
+		{
+			const float t = i - x[n - 1];
+			spectrum[i] = (c[n - 1] * t + b[n - 1]) * t + y[n - 1];
+		}
+	}
+};
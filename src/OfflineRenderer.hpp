@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameBuffer.hpp"
+#include "FrameWindows.hpp"
+#include "FrequencySpectrum.hpp"
+#include "SpectrumDrawer.hpp"
+#include "TerminalRenderer.hpp"
+
+/**
+ * Renders every frame of an audio file as fast as the cpu allows, without playing it,
+ * to an asciicast v2 recording or a raw ANSI stream.
+ * Each frame only depends on its own analysis window, so the file is split into chunks
+ * that are rendered on all cores, then written out in order.
+ */
+class OfflineRenderer
+{
+public:
+	enum class Format
+	{
+		ASCIICAST,
+		ANSI
+	};
+
+private:
+	// frames per chunk; every chunk starts with a full redraw, so this also bounds how far a diff reaches back
+	static constexpr int chunk_frames = 600;
+
+	std::string audio_file;
+	long total_frames;
+
+	// analysis window, video frame rate, and the grid size
+	int sample_size;
+	FrameTiming timing;
+	int width, height;
+
+	// configured by the caller; copied for every worker and chunk
+	const FrequencySpectrum &fs_template;
+	const SpectrumDrawer &drawer_template;
+
+	// encoded chunks waiting to be written, and how far the writer got
+	std::vector<std::string> chunks;
+	std::vector<bool> chunk_ready;
+	int next_chunk = 0, written_chunks = 0;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::exception_ptr error;
+
+public:
+	/**
+	 * @param audio_file file to render
+	 * @param fs spectrum generator with the settings to render with; channels must match `drawer.spectrum_count()`
+	 * @param drawer bar and color settings to render with
+	 * @param sample_size analysis window in frames of audio, same as `fs`'s fft size
+	 * @param timing when each video frame starts
+	 * @param width grid width in columns
+	 * @param height grid height in rows
+	 */
+	OfflineRenderer(const std::string &audio_file, const FrequencySpectrum &fs, const SpectrumDrawer &drawer,
+					const int sample_size, const FrameTiming &timing, const int width, const int height)
+		: audio_file(audio_file),
+		  sample_size(sample_size),
+		  timing(timing),
+		  width(width),
+		  height(height),
+		  fs_template(fs),
+		  drawer_template(drawer)
+	{
+		if (width <= 0 || height <= 0)
+			throw std::invalid_argument("OfflineRenderer: width and height must be positive");
+		total_frames = FrameWindows(audio_file, sample_size, timing).frames();
+	}
+
+	/**
+	 * Render the whole file to `path`.
+	 * @param path file to write
+	 * @param format output format
+	 * @param jobs number of worker threads, 0 for one per core
+	 * @return number of frames rendered
+	 * @throws `std::runtime_error` if `path` can't be written
+	 */
+	size_t render(const std::string &path, const Format format, int jobs = 0)
+	{
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+			throw std::runtime_error("cannot open render file: " + path);
+
+		const int chunk_count = (total_frames + chunk_frames - 1) / chunk_frames;
+		if (jobs <= 0)
+			jobs = std::max(1u, std::thread::hardware_concurrency());
+		jobs = std::clamp(jobs, 1, std::max(1, chunk_count));
+
+		chunks.assign(chunk_count, {});
+		chunk_ready.assign(chunk_count, false);
+		next_chunk = written_chunks = 0;
+		error = nullptr;
+
+		// fftw's planner isn't thread safe, so every worker's spectrum generator is planned here
+		std::vector<FrequencySpectrum> spectrum_pool(jobs, fs_template);
+		for (auto &fs : spectrum_pool)
+			fs.set_stats(nullptr);
+
+		if (format == Format::ASCIICAST)
+		{
+			char header[96];
+			snprintf(header, sizeof(header), "{\"version\": 2, \"width\": %d, \"height\": %d, \"env\": {\"TERM\": \"xterm-256color\"}}\n", width, height);
+			file << header;
+		}
+
+		std::vector<std::thread> workers;
+		for (int j = 0; j < jobs; ++j)
+			workers.emplace_back(&OfflineRenderer::work, this, std::ref(spectrum_pool[j]), format, jobs);
+
+		// write chunks as soon as they are done, in order, and free them
+		for (int c = 0; c < chunk_count; ++c)
+		{
+			std::unique_lock lock(mutex);
+			cv.wait(lock, [&] { return chunk_ready[c] || error; });
+			if (error)
+				break;
+			const auto chunk = std::move(chunks[c]);
+			lock.unlock();
+			file << chunk;
+			lock.lock();
+			++written_chunks;
+			cv.notify_all();
+		}
+
+		for (auto &worker : workers)
+			worker.join();
+		if (error)
+			std::rethrow_exception(error);
+
+		if (format == Format::ANSI)
+			file << "\e[0m\e[?25h";
+		if (!file.flush())
+			throw std::runtime_error("cannot write render file: " + path);
+		return total_frames;
+	}
+
+private:
+	// claim chunks until there are none left, staying at most `2 * jobs` chunks ahead of the writer to bound memory
+	void work(FrequencySpectrum &fs, const Format format, const int jobs)
+	{
+		try
+		{
+			FrameWindows windows(audio_file, sample_size, timing);
+			std::vector<std::vector<float>> spectra(fs.get_channels());
+			FrameBuffer frame;
+
+			for (;;)
+			{
+				int c;
+				{
+					std::unique_lock lock(mutex);
+					cv.wait(lock, [&] { return next_chunk < written_chunks + 2 * jobs || error; });
+					if (error || next_chunk == (int)chunks.size())
+						return;
+					c = next_chunk++;
+				}
+
+				const long first = (long)c * chunk_frames;
+				const long last = std::min(first + chunk_frames, total_frames);
+				auto chunk = render_chunk(windows, fs, spectra, frame, first, last, format);
+
+				const std::lock_guard lock(mutex);
+				chunks[c] = std::move(chunk);
+				chunk_ready[c] = true;
+				cv.notify_all();
+			}
+		}
+		catch (...)
+		{
+			const std::lock_guard lock(mutex);
+			if (!error)
+				error = std::current_exception();
+			cv.notify_all();
+		}
+	}
+
+	// render video frames [first, last)
+	std::string render_chunk(FrameWindows &windows, FrequencySpectrum &fs, std::vector<std::vector<float>> &spectra,
+							 FrameBuffer &frame, const long first, const long last, const Format format)
+	{
+		SpectrumDrawer drawer = drawer_template;
+		drawer.advance_wheel((int)first);
+		TerminalRenderer renderer(width, height);
+		for (auto &spectrum : spectra)
+			spectrum.assign(drawer.spectrum_width(width), 0);
+
+		windows.load(first, last);
+
+		std::string chunk;
+		for (long f = first; f < last; ++f)
+		{
+			windows.copy_to(f, fs);
+			fs.render(spectra);
+
+			drawer.draw(renderer, spectra);
+			if (f == 0)
+				frame.append("\e[?25l");
+			renderer.present(frame);
+			drawer.advance_wheel();
+
+			if (format == Format::ASCIICAST)
+				append_event(chunk, (double)windows.get_timing().start(f) / windows.samplerate(), frame.view());
+			else
+				chunk += frame.view();
+			frame.clear();
+		}
+		return chunk;
+	}
+
+	// asciicast v2 output event: [time, "o", "json escaped data"]
+	static void append_event(std::string &out, const double time, const std::string_view data)
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "[%.6f, \"o\", \"", time);
+		out += buf;
+		for (const unsigned char c : data)
+			switch (c)
+			{
+			case '"':
+				out += "\\\"";
+				break;
+			case '\\':
+				out += "\\\\";
+				break;
+			case '\n':
+				out += "\\n";
+				break;
+			case '\r':
+				out += "\\r";
+				break;
+			default:
+				if (c < 0x20)
+				{
+					snprintf(buf, sizeof(buf), "\\u%04x", c);
+					out += buf;
+				}
+				else
+					out += c;
+			}
+		out += "\"]\n";
+	}
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sndfile.hh>
+#include "CacheDir.hpp"
+
+/**
+ * An audio file decoded once into a memory-mapped float32 PCM file in `$XDG_CACHE_HOME/termviz/pcm`,
+ * named after a hash of the audio file's content. The first time a file is played, it is decoded
+ * by a background thread straight into the mapping while playback is already running from it.
+ * Later plays just map the finished file.
+ * Playback (`play`) and analysis (`read_window`) both read the same mapping, so decoded audio
+ * is never copied into an intermediate buffer.
+ */
+class PcmCache
+{
+	static constexpr char magic[8] = {'T', 'V', 'P', 'C', 'M', '1', 0, 0};
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t channels, samplerate;
+		uint64_t frames, reserved;
+	};
+
+	// frames decoded per `readf` in the background thread
+	static constexpr sf_count_t decode_block = 1 << 16;
+
+	std::filesystem::path path;
+	void *map_base = MAP_FAILED;
+	size_t map_size = 0;
+	float *data = nullptr;
+	int channels;
+	uint64_t total_frames;
+
+	// frames decoded into `data` so far; `decode_done` is set once no more will be
+	std::atomic<uint64_t> decoded = 0;
+	std::atomic<bool> decode_done = false, stop_decoding = false;
+	std::string decode_error;
+	std::thread decoder;
+
+	// playback position in frames, and frames played as silence because they weren't decoded yet
+	std::atomic<uint64_t> play_pos = 0;
+	std::atomic<size_t> underrun_frames = 0;
+
+public:
+	/**
+	 * Map the decoded PCM of `audio_file`, starting a background decode if it isn't cached yet.
+	 * Before starting a decode, least recently used PCM files are evicted until they and the new file add up to at most `max_bytes`.
+	 * @throws `std::runtime_error` if the cache file can't be created or mapped
+	 */
+	PcmCache(const std::string &audio_file, const uintmax_t max_bytes)
+	{
+		const auto dir = CacheDir::path() / "pcm";
+		std::filesystem::create_directories(dir);
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.f32", (unsigned long long)CacheDir::hash_file(audio_file));
+		path = dir / name;
+
+		if (std::filesystem::exists(path) && map_existing())
+		{
+			CacheDir::touch(path);
+			return;
+		}
+
+		SndfileHandle sf(audio_file);
+		channels = sf.channels();
+		total_frames = sf.frames();
+
+		// decoded into a temporary file that is renamed into place when complete,
+		// so an interrupted decode is never mistaken for a cached file
+		const auto tmp_path = path.string() + ".tmp" + std::to_string(getpid());
+		const auto file_size = sizeof(Header) + total_frames * channels * sizeof(float);
+
+		// the new file isn't in place until it is decoded, so make room for it up front
+		CacheDir::evict(dir, ".f32", max_bytes, path, file_size);
+		map_file(tmp_path, O_RDWR | O_CREAT | O_TRUNC, file_size);
+		auto &header = *(Header *)map_base;
+		memcpy(header.magic, magic, sizeof(magic));
+		header.channels = channels;
+		header.samplerate = sf.samplerate();
+		header.frames = total_frames;
+
+		decoder = std::thread(&PcmCache::decode, this, std::move(sf), tmp_path);
+	}
+
+	~PcmCache()
+	{
+		stop_decoding = true;
+		if (decoder.joinable())
+			decoder.join();
+		if (map_base != MAP_FAILED)
+			munmap(map_base, map_size);
+	}
+
+	PcmCache(const PcmCache &) = delete;
+	PcmCache &operator=(const PcmCache &) = delete;
+
+	int get_channels() const { return channels; }
+	uint64_t frames() const { return total_frames; }
+
+	// frames played so far
+	uint64_t playhead() const { return play_pos.load(std::memory_order_acquire); }
+
+	size_t underruns() const { return underrun_frames.load(std::memory_order_relaxed); }
+
+	// frames decoded so far, all of them once decoding is done
+	uint64_t decoded_frames() const { return decoded.load(std::memory_order_acquire); }
+
+	// whether everything that will ever be decoded has been played
+	bool finished() const
+	{
+		return decode_done.load(std::memory_order_acquire) && playhead() >= decoded.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * Rethrow a decoding error, if the background decode failed.
+	 * @throws `std::runtime_error` describing the error
+	 */
+	void check() const
+	{
+		if (decode_done.load(std::memory_order_acquire) && !decode_error.empty())
+			throw std::runtime_error(decode_error);
+	}
+
+	/**
+	 * Consumer: copy the next `n_frames` interleaved frames into `dst` and advance the playhead.
+	 * Frames that aren't decoded yet are played as silence and counted as underruns, without advancing.
+	 */
+	void play(float *const dst, const size_t n_frames)
+	{
+		const auto p = play_pos.load(std::memory_order_relaxed);
+		const auto n = std::min<uint64_t>(n_frames, decoded.load(std::memory_order_acquire) - p);
+		memcpy(dst, data + p * channels, n * channels * sizeof(float));
+		if (n < n_frames)
+		{
+			memset(dst + n * channels, 0, (n_frames - n) * channels * sizeof(float));
+			if (!decode_done.load(std::memory_order_relaxed))
+				underrun_frames.fetch_add(n_frames - n, std::memory_order_relaxed);
+		}
+		play_pos.store(p + n, std::memory_order_release);
+	}
+
+	/**
+	 * Copy one channel of the `n_frames` frames ending at frame `end` into `dst`.
+	 * Frames before the start of the file read as silence.
+	 * @param end must not be past the decoded frames, e.g. the playhead
+	 */
+	void read_window(float *const dst, const uint64_t end, const size_t n_frames, const int channel) const
+	{
+		const auto silent = (end < n_frames) ? (n_frames - end) : 0;
+		std::fill(dst, dst + silent, 0.f);
+		const float *src = data + ((end - n_frames + silent) * channels + channel);
+		for (size_t i = silent; i < n_frames; ++i, src += channels)
+			dst[i] = *src;
+	}
+
+private:
+	// map and validate a finished cache file, returns false (and removes it) if it isn't valid
+	bool map_existing()
+	{
+		if (std::filesystem::file_size(path) < sizeof(Header))
+		{
+			std::filesystem::remove(path);
+			return false;
+		}
+		map_file(path, O_RDONLY, 0);
+		const auto &header = *(const Header *)map_base;
+		if (memcmp(header.magic, magic, sizeof(magic)) ||
+			map_size != sizeof(Header) + header.frames * header.channels * sizeof(float))
+		{
+			munmap(map_base, map_size);
+			map_base = MAP_FAILED;
+			std::filesystem::remove(path);
+			return false;
+		}
+		channels = header.channels;
+		total_frames = header.frames;
+		decoded = total_frames;
+		decode_done = true;
+		return true;
+	}
+
+	// map `file`, sizing it to `size` bytes first if nonzero
+	void map_file(const std::filesystem::path &file, const int flags, size_t size)
+	{
+		const int fd = open(file.c_str(), flags, 0644);
+		if (fd == -1)
+			throw std::runtime_error("open " + file.string() + ": " + strerror(errno));
+		struct stat st;
+		if ((size && ftruncate(fd, size) == -1) || fstat(fd, &st) == -1)
+		{
+			const int e = errno;
+			close(fd);
+			throw std::runtime_error("cannot size " + file.string() + ": " + strerror(e));
+		}
+		map_size = st.st_size;
+		map_base = mmap(nullptr, map_size, (flags & O_RDWR) ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (map_base == MAP_FAILED)
+			throw std::runtime_error("mmap " + file.string() + ": " + strerror(errno));
+		data = (float *)((char *)map_base + sizeof(Header));
+	}
+
+	// background thread: decode straight into the mapping, publishing progress as it goes
+	void decode(SndfileHandle sf, const std::string tmp_path)
+	{
+		uint64_t pos = 0;
+		while (pos < total_frames && !stop_decoding)
+		{
+			const auto n = sf.readf(data + pos * channels, std::min<uint64_t>(decode_block, total_frames - pos));
+			if (n <= 0)
+				break;
+			decoded.store(pos += n, std::memory_order_release);
+		}
+
+		// no exceptions here: failing to keep the cache file doesn't stop playback from the mapping
+		std::error_code ec;
+		if (pos == total_frames)
+			std::filesystem::rename(tmp_path, path, ec);
+		else
+		{
+			// interrupted or shorter than advertised: play what there is, but don't keep it
+			std::filesystem::remove(tmp_path, ec);
+			if (!stop_decoding && sf.error())
+				decode_error = std::string("decoding failed: ") + sf.strError();
+		}
+		decode_done.store(true, std::memory_order_release);
+	}
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+
+/**
+ * Raw interleaved PCM read from a pipe (e.g. `ffmpeg -i ... -f f32le -`), for streams that can't be
+ * opened with libsndfile or seeked. Only reads what is already waiting, so a slow writer never stalls
+ * the caller, and only as much as the caller has room for, so a fast writer is held back by the pipe
+ * filling up. Memory use is constant however long the stream runs.
+ */
+class PcmPipe
+{
+public:
+	enum class Encoding
+	{
+		F32LE,
+		S16LE
+	};
+
+	struct Format
+	{
+		Encoding encoding = Encoding::F32LE;
+		int samplerate = 44100, channels = 2;
+
+		/**
+		 * Parse `ENCODING:RATE:CHANNELS`, e.g. `f32le:48000:2` or `s16le:44100:1`.
+		 * @throws `std::invalid_argument` if `spec` is malformed or out of range
+		 */
+		static Format parse(const std::string &spec)
+		{
+			Format format;
+			const auto colon1 = spec.find(':'), colon2 = spec.find(':', colon1 + 1);
+			if (colon1 == spec.npos || colon2 == spec.npos)
+				throw std::invalid_argument("stdin format must be ENCODING:RATE:CHANNELS: " + spec);
+			const auto encoding = spec.substr(0, colon1);
+			if (encoding == "f32le")
+				format.encoding = Encoding::F32LE;
+			else if (encoding == "s16le")
+				format.encoding = Encoding::S16LE;
+			else
+				throw std::invalid_argument("unknown stdin encoding: " + encoding);
+			format.samplerate = std::stoi(spec.substr(colon1 + 1, colon2 - colon1 - 1));
+			format.channels = std::stoi(spec.substr(colon2 + 1));
+			if (format.samplerate <= 0 || format.channels <= 0)
+				throw std::invalid_argument("stdin sample rate and channels must be positive: " + spec);
+			return format;
+		}
+
+		int sample_bytes() const { return (encoding == Encoding::F32LE) ? 4 : 2; }
+		int frame_bytes() const { return sample_bytes() * channels; }
+	};
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	int fd;
+	Format format;
+	bool at_eof = false;
+
+	// raw bytes read, including a partial frame left over from the last read
+	std::vector<char> bytes;
+	size_t leftover = 0;
+
+	// back-pressure: times the reader's buffer was full while input was waiting, and for how long in total
+	size_t overrun_count = 0;
+	Clock::duration backpressure_total{};
+	Clock::time_point held_since;
+	bool held = false;
+
+public:
+	/**
+	 * @param fd pipe to read, not closed by this object
+	 * @param format how the pcm in the pipe is encoded
+	 */
+	PcmPipe(const int fd, const Format &format)
+		: fd(fd),
+		  format(format)
+	{
+	}
+
+	PcmPipe(const PcmPipe &) = delete;
+	PcmPipe &operator=(const PcmPipe &) = delete;
+
+	const Format &get_format() const { return format; }
+
+	// the writer closed the pipe and every whole frame was read
+	bool eof() const { return at_eof; }
+
+	// whether input is waiting to be read
+	bool pending() const
+	{
+		pollfd p{fd, POLLIN, 0};
+		return poll(&p, 1, 0) > 0 && (p.revents & (POLLIN | POLLHUP));
+	}
+
+	/**
+	 * Read up to `n_frames` frames that are already waiting, without blocking.
+	 * @param dst destination for interleaved float frames, `n_frames` frames long
+	 * @returns frames read; 0 if nothing is waiting or the stream ended (see `eof`)
+	 * @throws `std::runtime_error` if reading fails
+	 */
+	size_t read(float *const dst, const size_t n_frames)
+	{
+		if (at_eof || !n_frames || !pending())
+			return 0;
+
+		const auto frame_bytes = format.frame_bytes();
+		bytes.resize(n_frames * frame_bytes);
+		ssize_t n;
+		do
+			n = ::read(fd, bytes.data() + leftover, bytes.size() - leftover);
+		while (n < 0 && errno == EINTR);
+		if (n < 0)
+			throw std::runtime_error(std::string("PcmPipe: read: ") + strerror(errno));
+		if (!n)
+		{
+			// a trailing partial frame is dropped
+			at_eof = true;
+			return 0;
+		}
+
+		const auto available = leftover + n;
+		const auto frames = available / frame_bytes;
+		convert(dst, frames * format.channels);
+		leftover = available - frames * frame_bytes;
+		memmove(bytes.data(), bytes.data() + frames * frame_bytes, leftover);
+		return frames;
+	}
+
+	/**
+	 * Tell the pipe whether its reader stopped reading with input still waiting, because it had no room.
+	 * The writer is then blocked by the pipe filling up; this counts how often and for how long.
+	 */
+	void set_held_back(const bool b)
+	{
+		if (b == held)
+			return;
+		const auto now = Clock::now();
+		if (b)
+		{
+			++overrun_count;
+			held_since = now;
+		}
+		else
+			backpressure_total += now - held_since;
+		held = b;
+	}
+
+	// times input arrived with no room for it; nothing is dropped, the writer is held back instead
+	size_t overruns() const { return overrun_count; }
+
+	// total time the writer was held back, in seconds
+	double backpressure() const
+	{
+		const auto total = held ? (backpressure_total + (Clock::now() - held_since)) : backpressure_total;
+		return std::chrono::duration<double>(total).count();
+	}
+
+private:
+	void convert(float *const dst, const size_t samples) const
+	{
+		if (format.encoding == Encoding::F32LE)
+			for (size_t i = 0; i < samples; ++i)
+			{
+				uint32_t bits;
+				memcpy(&bits, bytes.data() + i * 4, 4);
+				if constexpr (std::endian::native == std::endian::big)
+					bits = std::byteswap(bits);
+				dst[i] = std::bit_cast<float>(bits);
+			}
+		else
+			for (size_t i = 0; i < samples; ++i)
+			{
+				uint16_t bits;
+				memcpy(&bits, bytes.data() + i * 2, 2);
+				if constexpr (std::endian::native == std::endian::big)
+					bits = std::byteswap(bits);
+				dst[i] = (int16_t)bits * (1.f / 32768);
+			}
+	}
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <portaudio.h>
 
@@ -60,6 +61,26 @@ struct PortAudio
 			sample_size = framesPerBuffer;
 		}
 
+		void start()
+		{
+			PaError err;
+			if ((err = Pa_StartStream(stream)))
+				throw Error(Pa_GetErrorText(err));
+		}
+
+		void stop()
+		{
+			PaError err;
+			if ((err = Pa_StopStream(stream)))
+				throw Error(Pa_GetErrorText(err));
+		}
+
+		// current time on the clock of the stream's callback `PaStreamCallbackTimeInfo` times, in seconds
+		double time() const
+		{
+			return Pa_GetStreamTime(stream);
+		}
+
 		void write(const float *const buffer, const size_t n_frames)
 		{
 			PaError err;
@@ -91,4 +112,10 @@ struct PortAudio
 	{
 		return Stream(numInputChannels, numOutputChannels, sampleFormat, sampleRate, framesPerBuffer, streamCallback, userData);
 	}
+
+	// same as `stream`, for owners that open their stream after construction
+	std::unique_ptr<Stream> open_stream(int numInputChannels, int numOutputChannels, PaSampleFormat sampleFormat, double sampleRate, unsigned long framesPerBuffer, PaStreamCallback *streamCallback = NULL, void *userData = NULL)
+	{
+		return std::unique_ptr<Stream>(new Stream(numInputChannels, numOutputChannels, sampleFormat, sampleRate, framesPerBuffer, streamCallback, userData));
+	}
 };
\ No newline at end of file
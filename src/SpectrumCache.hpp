@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "CacheDir.hpp"
+#include "FrequencySpectrum.hpp"
+#include "SpectrumPrefetcher.hpp"
+
+/**
+ * On-disk cache of every frame's spectra for one audio file and one set of analysis settings.
+ * Spectra are stored at a canonical width as 16-bit square-root companded values, and the file is
+ * `mmap`ed on replay, so playing a cached file only costs resampling to the terminal's width.
+ * Cache files live in `$XDG_CACHE_HOME/termviz/spectra`, named after a hash of the audio file's content
+ * and the settings. Their modification time is their last use, and the least recently used files are
+ * evicted when the directory grows past a size cap.
+ */
+class SpectrumCache
+{
+public:
+	// width spectra are analysed and stored at
+	static constexpr int width = 512;
+
+private:
+	static constexpr char magic[8] = {'T', 'V', 'S', 'P', 'E', 'C', '2', 0};
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t width, channels;
+		uint64_t frames;
+	};
+
+	// quantized values cover [0, max_value]; bars are already clipped well below it at any sane multiplier
+	static constexpr float max_value = 16;
+
+	const uint16_t *data = nullptr;
+	size_t map_size = 0;
+	long n_frames;
+	int channels;
+
+	// resampling from `width` to `resample_width` columns: column `x` takes the max of
+	// [lo[x], hi[x]) when downsampling, or interpolates between lo[x] and lo[x] + 1 by frac[x] when upsampling
+	int resample_width = 0;
+	std::vector<int> lo, hi;
+	std::vector<float> frac;
+
+public:
+	/**
+	 * Map the cache of `audio_file` for `fs`'s settings, building it first if there is none.
+	 * Building renders every frame on all cores. Afterwards, least recently used cache files
+	 * are evicted until the cache directory is at most `max_bytes` big.
+	 * @param audio_file audio file to cache the spectra of
+	 * @param fs spectrum generator with the settings to render with
+	 * @param sample_size analysis window in frames of audio, same as `fs`'s fft size
+	 * @param timing when each video frame starts
+	 * @param max_bytes size cap of the cache directory
+	 * @throws `std::runtime_error` if the cache can't be read or written
+	 */
+	SpectrumCache(const std::string &audio_file, const FrequencySpectrum &fs, const int sample_size, const FrameTiming &timing, const uintmax_t max_bytes)
+	{
+		const auto dir = CacheDir::path() / "spectra";
+		std::filesystem::create_directories(dir);
+
+		char name[32];
+		const auto key = fs.settings_key() + " " + timing.key() + " w=" + std::to_string(width);
+		snprintf(name, sizeof(name), "%016llx.tvspec", (unsigned long long)CacheDir::hash(key.data(), key.size(), CacheDir::hash_file(audio_file)));
+		const auto path = dir / name;
+
+		if (std::filesystem::exists(path) && map(path))
+			CacheDir::touch(path);
+		else
+		{
+			build(path, audio_file, fs, sample_size, timing);
+			CacheDir::evict(dir, ".tvspec", max_bytes, path);
+			if (!map(path))
+				throw std::runtime_error("invalid spectrum cache: " + path.string());
+		}
+	}
+
+	~SpectrumCache()
+	{
+		if (data)
+			munmap((void *)data, map_size);
+	}
+
+	SpectrumCache(const SpectrumCache &) = delete;
+	SpectrumCache &operator=(const SpectrumCache &) = delete;
+
+	long frames() const { return n_frames; }
+	int get_channels() const { return channels; }
+
+	/**
+	 * Dequantize video frame `frame` and resample it to the spectra's width.
+	 * @param frame video frame, clamped to the cached frames
+	 * @param spectra one spectrum per cached channel, all of the same size
+	 */
+	void read(long frame, std::vector<std::vector<float>> &spectra)
+	{
+		frame = std::clamp(frame, 0l, n_frames - 1);
+		const int out_width = spectra[0].size();
+		if (out_width != resample_width)
+			build_resample_map(out_width);
+
+		float row[width];
+		for (int ch = 0; ch < std::min(channels, (int)spectra.size()); ++ch)
+		{
+			const uint16_t *const q = data + ((size_t)frame * channels + ch) * width;
+			for (int i = 0; i < width; ++i)
+				row[i] = dequantize(q[i]);
+
+			auto &spectrum = spectra[ch];
+			if (out_width <= width)
+				for (int x = 0; x < out_width; ++x)
+					spectrum[x] = *std::max_element(row + lo[x], row + hi[x]);
+			else
+				for (int x = 0; x < out_width; ++x)
+					spectrum[x] = row[lo[x]] + frac[x] * (row[std::min(lo[x] + 1, width - 1)] - row[lo[x]]);
+		}
+	}
+
+private:
+	static uint16_t quantize(const float v)
+	{
+		return std::lround(std::sqrt(std::clamp(v / max_value, 0.f, 1.f)) * UINT16_MAX);
+	}
+
+	static float dequantize(const uint16_t q)
+	{
+		const float r = q * (1.f / UINT16_MAX);
+		return r * r * max_value;
+	}
+
+	// render every frame with a prefetcher on all cores, consuming it in order; written to a temporary file
+	// that is renamed into place, so concurrent players never see a partial cache
+	static void build(const std::filesystem::path &path, const std::string &audio_file, const FrequencySpectrum &fs, const int sample_size, const FrameTiming &timing)
+	{
+		const long frames = FrameWindows(audio_file, sample_size, timing).frames();
+		const auto tmp_path = path.string() + ".tmp" + std::to_string(getpid());
+		std::ofstream file(tmp_path, std::ios::binary);
+		if (!file)
+			throw std::runtime_error("cannot write spectrum cache: " + tmp_path);
+
+		Header header{};
+		memcpy(header.magic, magic, sizeof(magic));
+		header.width = width;
+		header.channels = fs.get_channels();
+		header.frames = frames;
+		file.write((const char *)&header, sizeof(header));
+
+		{
+			SpectrumPrefetcher prefetcher(audio_file, fs, width, sample_size, timing, std::max(1u, std::thread::hardware_concurrency()));
+			std::vector<uint16_t> q(width);
+			for (long f = 0; f < frames; ++f)
+				for (const auto &spectrum : prefetcher.get(f))
+				{
+					std::ranges::transform(spectrum, q.begin(), quantize);
+					file.write((const char *)q.data(), q.size() * sizeof(uint16_t));
+				}
+		}
+
+		if (!file.flush())
+			throw std::runtime_error("cannot write spectrum cache: " + tmp_path);
+		file.close();
+		std::filesystem::rename(tmp_path, path);
+	}
+
+	// map `path` and check its header, returns false (and removes it) if it isn't a valid cache file
+	bool map(const std::filesystem::path &path)
+	{
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd == -1)
+			throw std::runtime_error("open " + path.string() + ": " + strerror(errno));
+		struct stat st;
+		if (fstat(fd, &st) == -1)
+		{
+			close(fd);
+			throw std::runtime_error("fstat " + path.string() + ": " + strerror(errno));
+		}
+		map_size = st.st_size;
+		if (map_size < sizeof(Header))
+		{
+			close(fd);
+			std::filesystem::remove(path);
+			return false;
+		}
+		void *const p = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED)
+			throw std::runtime_error("mmap " + path.string() + ": " + strerror(errno));
+
+		const auto &header = *(const Header *)p;
+		data = (const uint16_t *)((const char *)p + sizeof(Header));
+		n_frames = header.frames;
+		channels = header.channels;
+		if (memcmp(header.magic, magic, sizeof(magic)) || header.width != width || !n_frames ||
+			map_size != sizeof(Header) + (size_t)n_frames * channels * width * sizeof(uint16_t))
+		{
+			munmap(p, map_size);
+			data = nullptr;
+			std::filesystem::remove(path);
+			return false;
+		}
+		return true;
+	}
+
+	void build_resample_map(const int out_width)
+	{
+		resample_width = out_width;
+		lo.resize(out_width);
+		hi.resize(out_width);
+		frac.resize(out_width);
+		for (int x = 0; x < out_width; ++x)
+			if (out_width <= width)
+			{
+				lo[x] = (long)x * width / out_width;
+				hi[x] = std::max(lo[x] + 1, (int)((long)(x + 1) * width / out_width));
+			}
+			else
+			{
+				const float pos = (out_width > 1) ? (float)x * (width - 1) / (out_width - 1) : 0;
+				lo[x] = pos;
+				frac[x] = pos - lo[x];
+			}
+	}
+};
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "ColorUtils.hpp"
+#include "TerminalRenderer.hpp"
+
+/**
+ * Turns rendered spectra into colored bars on a `TerminalRenderer`'s grid.
+ * Holds all of the appearance settings: characters, colors, multiplier and the stereo layout.
+ */
+class SpectrumDrawer
+{
+public:
+	enum class ColorType
+	{
+		NONE,
+		WHEEL,
+		SOLID,
+		GRADIENT
+	};
+
+private:
+	// color
+	ColorType color_type = ColorType::WHEEL;
+	std::tuple<int, int, int> solid_rgb{255, 0, 255};
+
+	// `GRADIENT` colors sampled across the spectrum, mirrored like the wheel in stereo
+	static constexpr int gradient_table_size = 1024;
+	std::vector<TerminalRenderer::Color> gradient_table;
+
+	// characters
+	char peak_char = 0;
+	std::string characters = "#";
+
+	// color wheel rotation
+	struct
+	{
+		float time = 0, rate = 0;
+		std::tuple<float, float, float> hsv{0.9, 0.7, 1};
+	} wheel;
+
+	// spectrum - final multiplier
+	float multiplier = 3;
+
+	// mirrored stereo layout: two spectra, each half as wide as the terminal
+	bool stereo = false;
+
+	// the wheel's colors at `hue_ring_size` evenly spaced hues, offset by the wheel's hue.
+	// finer than the number of distinct 8-bit hues, so looking colors up loses nothing visible.
+	static constexpr int hue_ring_size = 2048;
+	std::vector<TerminalRenderer::Color> hue_ring;
+
+	// per screen column: its position on the hue ring for the wheel, or its color otherwise.
+	// only rebuilt when the width or colors change; the wheel turning just shifts the ring index
+	std::vector<TerminalRenderer::Color> column_colors;
+	int columns_width = -1;
+
+	// this frame's bar of every screen column, handed to the renderer all at once
+	std::vector<int> bar_heights;
+	std::vector<TerminalRenderer::Color> bar_colors;
+
+public:
+	/**
+	 * Set the character(s) to print (in order) as the bar is printed upwards.
+	 * @param characters new characters to use
+	 * @return reference to self
+	 */
+	SpectrumDrawer &set_characters(const std::string &characters)
+	{
+		this->characters = characters;
+		return *this;
+	}
+
+	/**
+	 * Set the character to print at the peak of a spectrum bar.
+	 * @param peak_char new peak char to use
+	 * @return reference to self
+	 */
+	SpectrumDrawer &set_peak_char(const char peak_char)
+	{
+		this->peak_char = peak_char;
+		return *this;
+	}
+
+	/**
+	 * Set the spectrum coloring type.
+	 * @param color_type new coloring type to use
+	 * @return reference to self
+	 */
+	SpectrumDrawer &set_color_type(const ColorType color_type)
+	{
+		this->color_type = color_type;
+		columns_width = -1;
+		return *this;
+	}
+
+	/**
+	 * Set the rate at which the color wheel rotates per frame.
+	 * @param rate new wheel rate to use
+	 * @return reference to self
+	 */
+	SpectrumDrawer &set_wheel_rate(const float rate)
+	{
+		wheel.rate = rate;
+		return *this;
+	}
+
+	/**
+	 * Set the color to use when coloring the spectrum with a solid color.
+	 * @param rgb (red, green, blue) tuple
+	 * @return reference to self
+	 */
+	SpectrumDrawer &set_solid_color(const std::tuple<int, int, int> rgb)
+	{
+		this->solid_rgb = rgb;
+		columns_width = -1;
+		return *this;
+	}
+
+	/**
+	 * Set the hue offset, saturation, and value (brightness) of the color wheel.
+	 * @param hsv (hue, saturation, value) tuple
+	 * @return reference to self
+	 */
+	SpectrumDrawer &set_wheel_hsv(const std::tuple<float, float, float> hsv)
+	{
+		const auto [h, s, v] = hsv;
+		if (s < 0 || s > 1 || v < 0 || v > 1)
+			throw std::invalid_argument("wheel saturation and value must be in [0, 1]");
+		wheel.hsv = hsv;
+		hue_ring.clear();
+		columns_width = -1;
+		return *this;
+	}
+
+	/**
+	 * Set the gradient to color the spectrum with when the color type is `GRADIENT`.
+	 * It is sampled into a table once, so it costs the same per frame as a solid color however many stops it has.
+	 * @param gradient gradient from the left to the right of the spectrum
+	 * @return reference to self
+	 */
+	SpectrumDrawer &set_gradient(const ColorUtils::Gradient &gradient)
+	{
+		gradient_table = gradient.table(gradient_table_size);
+		columns_width = -1;
+		return *this;
+	}
+
+	/**
+	 * Set the multiplier to multiply the spectrum's height by.
+	 * @param multiplier new multiplier to use
+	 * @return reference to self
+	 */
+	SpectrumDrawer &set_multiplier(const float multiplier)
+	{
+		this->multiplier = multiplier;
+		return *this;
+	}
+
+	/**
+	 * Enable or disable the mirrored stereo layout.
+	 * @param b whether to draw two mirrored spectra
+	 * @return reference to self
+	 */
+	SpectrumDrawer &set_stereo(const bool b)
+	{
+		stereo = b;
+		columns_width = -1;
+		return *this;
+	}
+
+	bool is_stereo() const { return stereo; }
+
+	// number of spectra `draw` expects
+	int spectrum_count() const { return stereo ? 2 : 1; }
+
+	// width each spectrum should have for a terminal `width` columns wide
+	int spectrum_width(const int width) const { return stereo ? (width / 2) : width; }
+
+	/**
+	 * Draw the spectra as bars onto the whole back grid of `renderer`, replacing what was on it.
+	 * @param renderer renderer to draw on
+	 * @param spectra `spectrum_count()` spectra, each `spectrum_width(renderer.get_width())` wide
+	 */
+	void draw(TerminalRenderer &renderer, const std::vector<std::vector<float>> &spectra)
+	{
+		const auto width = renderer.get_width();
+		if (columns_width != width)
+			build_column_colors(width);
+		bar_heights.resize(width);
+		bar_colors.resize(width);
+		if (stereo)
+		{
+			draw_half(renderer, spectra, 1);
+			draw_half(renderer, spectra, 2);
+		}
+		else
+			draw_full(renderer, spectra[0]);
+
+		const auto phase = wheel_phase();
+		for (int i = 0; i < width; ++i)
+			bar_colors[i] = column_color(i, phase);
+		renderer.draw_bars(bar_heights, bar_colors, characters, peak_char);
+	}
+
+	// move the color wheel along by `frames` frames
+	void advance_wheel(const int frames = 1)
+	{
+		wheel.time += wheel.rate * frames;
+	}
+
+private:
+	void draw_full(const TerminalRenderer &renderer, const std::vector<float> &spectrum)
+	{
+		const auto width = renderer.get_width(), height = renderer.get_height();
+		for (int i = 0; i < width; ++i)
+			bar_heights[i] = multiplier * spectrum[width - 1 - i] * height;
+	}
+
+	// left half: first channel mirrored, right half: second channel
+	void draw_half(const TerminalRenderer &renderer, const std::vector<std::vector<float>> &spectra, int half)
+	{
+		const auto width = renderer.get_width(), height = renderer.get_height();
+		const auto half_width = width / 2;
+		const auto &spectrum = spectra[half - 1];
+
+		if (half == 1)
+			for (int i = half_width - 1; i >= 0; --i)
+				bar_heights[i] = multiplier * spectrum[half_width - 1 - i] * height;
+
+		else if (half == 2)
+			for (int i = half_width; i < width; ++i)
+				bar_heights[i] = multiplier * spectrum[std::min(i - half_width, (int)spectrum.size() - 1)] * height;
+	}
+
+	// how far the wheel has turned, in steps of the hue ring
+	uint32_t wheel_phase() const
+	{
+		return (uint32_t)std::lround(wheel.time * hue_ring_size);
+	}
+
+	// color of screen column `x`, with the wheel turned by `phase`
+	TerminalRenderer::Color column_color(const int x, const uint32_t phase) const
+	{
+		if (color_type != ColorType::WHEEL)
+			return column_colors[x];
+		return hue_ring[(column_colors[x] + phase) & (hue_ring_size - 1)];
+	}
+
+	// horizontal position of screen column `x` as a ratio of the spectrum width; a full turn of the wheel spans 1
+	float column_ratio(const int x, const int width) const
+	{
+		if (!stereo)
+			return (float)x / width;
+		const auto half_width = width / 2;
+		return (x < half_width) ? ((float)(half_width - x) / half_width) : ((float)x / half_width);
+	}
+
+	void build_column_colors(const int width)
+	{
+		if (color_type == ColorType::WHEEL && hue_ring.empty())
+			build_hue_ring();
+		column_colors.resize(width);
+		for (int x = 0; x < width; ++x)
+			switch (color_type)
+			{
+			case ColorType::WHEEL:
+				column_colors[x] = (uint32_t)std::lround(column_ratio(x, width) * hue_ring_size);
+				break;
+			case ColorType::SOLID:
+			{
+				const auto [r, g, b] = solid_rgb;
+				column_colors[x] = TerminalRenderer::rgb(r, g, b);
+				break;
+			}
+			case ColorType::GRADIENT:
+			{
+				if (gradient_table.empty())
+					throw std::logic_error("SpectrumDrawer: GRADIENT color type without a gradient");
+				// gradients aren't cyclic: in stereo, each half runs from the start color at the center to the end color at its edge
+				auto ratio = column_ratio(x, width);
+				if (stereo && x >= width / 2)
+					ratio -= 1;
+				column_colors[x] = gradient_table[std::lround(std::clamp(ratio, 0.f, 1.f) * (gradient_table_size - 1))];
+				break;
+			}
+			case ColorType::NONE:
+				column_colors[x] = TerminalRenderer::DEFAULT_COLOR;
+				break;
+			default:
+				throw std::logic_error("SpectrumDrawer::build_column_colors: default case hit");
+			}
+		columns_width = width;
+	}
+
+	// one full turn of hue, starting at the wheel's hue offset
+	void build_hue_ring()
+	{
+		const auto [h, s, v] = wheel.hsv;
+		using Gradient = ColorUtils::Gradient;
+		hue_ring = Gradient(Gradient::Space::HSV, {{0, h, s, v}, {1, h + 1, s, v}}).table(hue_ring_size, true);
+	}
+};
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <fftw3.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TERMVIZ_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Hot loops of `FrequencySpectrum::render`: fft output -> bin magnitudes -> column reduction.
+ * Each kernel has a scalar version plus SSE2/AVX2/AVX-512 versions picked at runtime.
+ * All versions produce bit-identical output, so they can be checked against each other:
+ * - magnitudes are `sqrt(re * re + im * im)` with no fused multiply-add and a correctly rounded sqrt
+ * - sums accumulate 8 interleaved lanes over each full block of 8 bins, combine the lanes in a fixed
+ *   order, then add the remaining bins in order; the scalar version emulates the same lanes
+ * - max is exact regardless of order
+ */
+namespace SpectrumKernels
+{
+	enum class Isa
+	{
+		SCALAR,
+		SSE2,
+		AVX2,
+		AVX512
+	};
+
+	// out[i] = |in[i]| for i in [0, n)
+	using MagnitudesFn = void (*)(const fftwf_complex *in, float *out, int n);
+
+	// out[c] = reduction of in[offsets[c]] .. in[offsets[c + 1] - 1] for c in [0, width), 0 for empty ranges
+	using ReduceFn = void (*)(const float *in, const int *offsets, float *out, int width);
+
+	struct Kernels
+	{
+		Isa isa;
+		const char *name;
+		MagnitudesFn magnitudes;
+		ReduceFn reduce_sum, reduce_max;
+	};
+
+// keep mul + add separate even when a target has fma, so every version rounds the same way
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+
+// gcc's avx-512 intrinsics trip -Wmaybe-uninitialized on their own `_mm512_undefined_*` placeholders
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+	void magnitudes_scalar(const fftwf_complex *const in, float *const out, const int n)
+	{
+		for (int i = 0; i < n; ++i)
+			out[i] = std::sqrt(in[i][0] * in[i][0] + in[i][1] * in[i][1]);
+	}
+
+	void reduce_sum_scalar(const float *const in, const int *const offsets, float *const out, const int width)
+	{
+		for (int c = 0; c < width; ++c)
+		{
+			int i = offsets[c];
+			const int end = offsets[c + 1];
+			float lanes[8]{};
+			for (; i + 8 <= end; i += 8)
+				for (int j = 0; j < 8; ++j)
+					lanes[j] += in[i + j];
+			float sum = ((lanes[0] + lanes[4]) + (lanes[2] + lanes[6])) + ((lanes[1] + lanes[5]) + (lanes[3] + lanes[7]));
+			for (; i < end; ++i)
+				sum += in[i];
+			out[c] = sum;
+		}
+	}
+
+	void reduce_max_scalar(const float *const in, const int *const offsets, float *const out, const int width)
+	{
+		for (int c = 0; c < width; ++c)
+		{
+			float max = 0;
+			for (int i = offsets[c]; i < offsets[c + 1]; ++i)
+				max = std::max(max, in[i]);
+			out[c] = max;
+		}
+	}
+
+#ifdef TERMVIZ_X86
+	[[gnu::target("sse2")]] void magnitudes_sse2(const fftwf_complex *const in, float *const out, const int n)
+	{
+		const float *const f = (const float *)in;
+		int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			const auto a = _mm_loadu_ps(f + 2 * i), b = _mm_loadu_ps(f + 2 * i + 4);
+			const auto re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			const auto im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			_mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im))));
+		}
+		magnitudes_scalar(in + i, out + i, n - i);
+	}
+
+	// combine 8 lanes held as lo = lanes 0-3, hi = lanes 4-7, in the canonical order
+	[[gnu::target("sse2")]] float hsum_sse2(const __m128 lo, const __m128 hi)
+	{
+		const auto s4 = _mm_add_ps(lo, hi);
+		const auto s2 = _mm_add_ps(s4, _mm_movehl_ps(s4, s4));
+		return _mm_cvtss_f32(_mm_add_ss(s2, _mm_shuffle_ps(s2, s2, _MM_SHUFFLE(1, 1, 1, 1))));
+	}
+
+	[[gnu::target("sse2")]] void reduce_sum_sse2(const float *const in, const int *const offsets, float *const out, const int width)
+	{
+		for (int c = 0; c < width; ++c)
+		{
+			int i = offsets[c];
+			const int end = offsets[c + 1];
+			auto lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+			for (; i + 8 <= end; i += 8)
+			{
+				lo = _mm_add_ps(lo, _mm_loadu_ps(in + i));
+				hi = _mm_add_ps(hi, _mm_loadu_ps(in + i + 4));
+			}
+			float sum = hsum_sse2(lo, hi);
+			for (; i < end; ++i)
+				sum += in[i];
+			out[c] = sum;
+		}
+	}
+
+	[[gnu::target("sse2")]] void reduce_max_sse2(const float *const in, const int *const offsets, float *const out, const int width)
+	{
+		for (int c = 0; c < width; ++c)
+		{
+			int i = offsets[c];
+			const int end = offsets[c + 1];
+			auto m = _mm_setzero_ps();
+			for (; i + 4 <= end; i += 4)
+				m = _mm_max_ps(m, _mm_loadu_ps(in + i));
+			m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+			float max = _mm_cvtss_f32(_mm_max_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1))));
+			for (; i < end; ++i)
+				max = std::max(max, in[i]);
+			out[c] = max;
+		}
+	}
+
+	[[gnu::target("avx2")]] void magnitudes_avx2(const fftwf_complex *const in, float *const out, const int n)
+	{
+		const float *const f = (const float *)in;
+		int i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			const auto a = _mm256_loadu_ps(f + 2 * i), b = _mm256_loadu_ps(f + 2 * i + 8);
+			// within each 128-bit lane, giving bins 0 1 4 5 | 2 3 6 7
+			const auto re = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			const auto im = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			const auto mag = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im)));
+			// reorder the 64-bit pairs to bins 0 1 2 3 | 4 5 6 7
+			_mm256_storeu_ps(out + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(mag), _MM_SHUFFLE(3, 1, 2, 0))));
+		}
+		magnitudes_sse2(in + i, out + i, n - i);
+	}
+
+	[[gnu::target("avx2")]] void reduce_sum_avx2(const float *const in, const int *const offsets, float *const out, const int width)
+	{
+		for (int c = 0; c < width; ++c)
+		{
+			int i = offsets[c];
+			const int end = offsets[c + 1];
+			auto lanes = _mm256_setzero_ps();
+			for (; i + 8 <= end; i += 8)
+				lanes = _mm256_add_ps(lanes, _mm256_loadu_ps(in + i));
+			float sum = hsum_sse2(_mm256_castps256_ps128(lanes), _mm256_extractf128_ps(lanes, 1));
+			for (; i < end; ++i)
+				sum += in[i];
+			out[c] = sum;
+		}
+	}
+
+	[[gnu::target("avx2")]] void reduce_max_avx2(const float *const in, const int *const offsets, float *const out, const int width)
+	{
+		for (int c = 0; c < width; ++c)
+		{
+			int i = offsets[c];
+			const int end = offsets[c + 1];
+			auto m8 = _mm256_setzero_ps();
+			for (; i + 8 <= end; i += 8)
+				m8 = _mm256_max_ps(m8, _mm256_loadu_ps(in + i));
+			auto m = _mm_max_ps(_mm256_castps256_ps128(m8), _mm256_extractf128_ps(m8, 1));
+			m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+			float max = _mm_cvtss_f32(_mm_max_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1))));
+			for (; i < end; ++i)
+				max = std::max(max, in[i]);
+			out[c] = max;
+		}
+	}
+
+	[[gnu::target("avx512f")]] void magnitudes_avx512(const fftwf_complex *const in, float *const out, const int n)
+	{
+		const float *const f = (const float *)in;
+		const auto even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+		const auto odd = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+		int i = 0;
+		for (; i + 16 <= n; i += 16)
+		{
+			const auto a = _mm512_loadu_ps(f + 2 * i), b = _mm512_loadu_ps(f + 2 * i + 16);
+			const auto re = _mm512_permutex2var_ps(a, even, b);
+			const auto im = _mm512_permutex2var_ps(a, odd, b);
+			_mm512_storeu_ps(out + i, _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(re, re), _mm512_mul_ps(im, im))));
+		}
+		magnitudes_avx2(in + i, out + i, n - i);
+	}
+
+	[[gnu::target("avx512f")]] void reduce_max_avx512(const float *const in, const int *const offsets, float *const out, const int width)
+	{
+		for (int c = 0; c < width; ++c)
+		{
+			int i = offsets[c];
+			const int end = offsets[c + 1];
+			auto m16 = _mm512_setzero_ps();
+			for (; i + 16 <= end; i += 16)
+				m16 = _mm512_max_ps(m16, _mm512_loadu_ps(in + i));
+			float max = _mm512_reduce_max_ps(m16);
+			for (; i < end; ++i)
+				max = std::max(max, in[i]);
+			out[c] = max;
+		}
+	}
+#endif
+
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+
+	/**
+	 * @param isa instruction set to check
+	 * @returns whether this cpu (and build) can run the kernels for `isa`
+	 */
+	bool supported(const Isa isa)
+	{
+		switch (isa)
+		{
+		case Isa::SCALAR:
+			return true;
+#ifdef TERMVIZ_X86
+		case Isa::SSE2:
+			return __builtin_cpu_supports("sse2");
+		case Isa::AVX2:
+			return __builtin_cpu_supports("avx2");
+		case Isa::AVX512:
+			return __builtin_cpu_supports("avx512f");
+#endif
+		default:
+			return false;
+		}
+	}
+
+	/**
+	 * @param isa instruction set to get kernels for
+	 * @returns the kernels for `isa`
+	 * @throws `std::invalid_argument` if `isa` isn't supported on this cpu
+	 */
+	const Kernels &get(const Isa isa)
+	{
+		static const Kernels scalar{Isa::SCALAR, "scalar", magnitudes_scalar, reduce_sum_scalar, reduce_max_scalar};
+#ifdef TERMVIZ_X86
+		// the 8-lane sum order is kept with 256-bit vectors on avx-512
+		static const Kernels sse2{Isa::SSE2, "sse2", magnitudes_sse2, reduce_sum_sse2, reduce_max_sse2};
+		static const Kernels avx2{Isa::AVX2, "avx2", magnitudes_avx2, reduce_sum_avx2, reduce_max_avx2};
+		static const Kernels avx512{Isa::AVX512, "avx512", magnitudes_avx512, reduce_sum_avx2, reduce_max_avx512};
+#endif
+
+		if (!supported(isa))
+			throw std::invalid_argument("SpectrumKernels::get: instruction set not supported on this cpu");
+
+		switch (isa)
+		{
+#ifdef TERMVIZ_X86
+		case Isa::SSE2:
+			return sse2;
+		case Isa::AVX2:
+			return avx2;
+		case Isa::AVX512:
+			return avx512;
+#endif
+		default:
+			return scalar;
+		}
+	}
+
+	/**
+	 * @returns the kernels for the widest instruction set this cpu supports
+	 */
+	const Kernels &best()
+	{
+		for (const auto isa : {Isa::AVX512, Isa::AVX2, Isa::SSE2})
+			if (supported(isa))
+				return get(isa);
+		return get(Isa::SCALAR);
+	}
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameWindows.hpp"
+#include "FrequencySpectrum.hpp"
+
+/**
+ * Computes the spectra of upcoming video frames on a pool of worker threads, ahead of playback,
+ * into a bounded ring of ready frames. Works because the whole future of a file is already known:
+ * workers read their frames' windows straight from the file (see `FrameWindows`).
+ * The playback thread just asks for the frame matching the playhead with `get`.
+ */
+class SpectrumPrefetcher
+{
+	// consecutive frames a worker claims at once, so it reads their overlapping windows with one seek
+	static constexpr int batch = 8;
+
+	struct Slot
+	{
+		// frame held in `spectra`, -1 if none
+		long frame = -1;
+		std::vector<std::vector<float>> spectra;
+	};
+
+	std::string audio_file;
+	int sample_size;
+	FrameTiming timing;
+	long total_frames;
+
+	// one per worker, planned on the constructing thread since fftw's planner isn't thread safe
+	std::vector<FrequencySpectrum> spectrum_pool;
+
+	// frame `f` is computed into `slots[f % slots.size()]`.
+	// workers only compute frames in [`consumed`, `consumed + slots.size()`), so the frame
+	// the playback thread is drawing is never overwritten.
+	std::vector<Slot> slots;
+	long next = 0, consumed = 0;
+
+	// returned for frames no worker will ever compute: past the end of the file, or of an empty one
+	std::vector<std::vector<float>> silence;
+	bool stopping = false;
+	std::exception_ptr error;
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	std::vector<std::thread> workers;
+
+public:
+	/**
+	 * Start computing spectra from `start_frame` onwards.
+	 * @param audio_file file being played
+	 * @param fs spectrum generator with the settings to compute with
+	 * @param width width of every spectrum
+	 * @param sample_size analysis window in frames of audio, same as `fs`'s fft size
+	 * @param timing when each video frame starts
+	 * @param jobs number of worker threads
+	 * @param start_frame first video frame to compute
+	 */
+	SpectrumPrefetcher(const std::string &audio_file, const FrequencySpectrum &fs, const int width,
+					   const int sample_size, const FrameTiming &timing, const int jobs, const long start_frame = 0)
+		: audio_file(audio_file),
+		  sample_size(sample_size),
+		  timing(timing),
+		  total_frames(FrameWindows(audio_file, sample_size, timing).frames()),
+		  spectrum_pool(jobs, fs),
+		  slots(2 * jobs * batch),
+		  next(start_frame),
+		  consumed(start_frame)
+	{
+		for (auto &slot : slots)
+			slot.spectra.assign(fs.get_channels(), std::vector<float>(width));
+		silence.assign(fs.get_channels(), std::vector<float>(width));
+		for (auto &worker_fs : spectrum_pool)
+			worker_fs.set_stats(nullptr);
+		for (auto &worker_fs : spectrum_pool)
+			workers.emplace_back(&SpectrumPrefetcher::work, this, std::ref(worker_fs), width);
+	}
+
+	~SpectrumPrefetcher()
+	{
+		{
+			const std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		cv.notify_all();
+		for (auto &worker : workers)
+			worker.join();
+	}
+
+	SpectrumPrefetcher(const SpectrumPrefetcher &) = delete;
+	SpectrumPrefetcher &operator=(const SpectrumPrefetcher &) = delete;
+
+	/**
+	 * Wait for the spectra of video frame `frame`, and give up on every frame before it.
+	 * Frames must be asked for in nondecreasing order; earlier frames and frames past the end are clamped.
+	 * @returns the spectra, valid until the next call. silent if there is no frame to clamp to,
+	 * i.e. the file is empty or the prefetcher started past its end
+	 * @throws whatever a worker threw while reading or transforming
+	 */
+	const std::vector<std::vector<float>> &get(long frame)
+	{
+		std::unique_lock lock(mutex);
+		frame = std::min(std::max(frame, consumed), total_frames - 1);
+		// workers stop at `total_frames`, so don't wait for a frame they will never compute
+		if (frame < consumed)
+			return silence;
+		if (frame > consumed)
+		{
+			consumed = frame;
+			next = std::max(next, frame);
+			cv.notify_all();
+		}
+		auto &slot = slots[frame % slots.size()];
+		cv.wait(lock, [&] { return slot.frame == frame || error; });
+		if (error)
+			std::rethrow_exception(error);
+		return slot.spectra;
+	}
+
+private:
+	void work(FrequencySpectrum &fs, const int width)
+	{
+		try
+		{
+			FrameWindows windows(audio_file, sample_size, timing);
+			std::vector<std::vector<float>> spectra(fs.get_channels(), std::vector<float>(width));
+
+			for (;;)
+			{
+				long first, last;
+				{
+					std::unique_lock lock(mutex);
+					cv.wait(lock, [&] { return stopping || next >= total_frames || next < consumed + (long)slots.size(); });
+					if (stopping || next >= total_frames)
+						return;
+					first = next;
+					last = std::min({first + batch, consumed + (long)slots.size(), total_frames});
+					next = last;
+				}
+
+				windows.load(first, last);
+				for (long f = first; f < last; ++f)
+				{
+					windows.copy_to(f, fs);
+					fs.render(spectra);
+
+					// the playback thread may have skipped past this frame in the meantime
+					const std::lock_guard lock(mutex);
+					if (f < consumed)
+						continue;
+					auto &slot = slots[f % slots.size()];
+					slot.spectra = spectra;
+					slot.frame = f;
+					cv.notify_all();
+				}
+			}
+		}
+		catch (...)
+		{
+			const std::lock_guard lock(mutex);
+			if (!error)
+				error = std::current_exception();
+			cv.notify_all();
+		}
+	}
+};
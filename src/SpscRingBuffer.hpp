@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <vector>
+
+/**
+ * Lock-free single-producer/single-consumer ring buffer of interleaved float frames.
+ * The producer writes audio ahead of the playhead and the consumer (e.g. an audio callback) plays it.
+ * Consumed frames are free to be overwritten at once; analysis keeps its own copy of the samples.
+ */
+class SpscRingBuffer
+{
+	int channels;
+
+	// capacity in frames, always a power of two
+	size_t capacity, mask;
+
+	std::vector<float> buf;
+
+	// total frames written/read since construction; only ever increase
+	alignas(64) std::atomic<size_t> write_pos = 0;
+	alignas(64) std::atomic<size_t> read_pos = 0;
+
+	// frames the consumer wanted but were not available, while more were still to come
+	std::atomic<size_t> underrun_frames = 0;
+	std::atomic<bool> closed = false;
+
+public:
+	/**
+	 * @param channels number of interleaved channels per frame
+	 * @param slack frames the producer may buffer ahead of the consumer, rounded up to a power of two
+	 */
+	SpscRingBuffer(const int channels, const size_t slack)
+		: channels(channels),
+		  capacity(std::bit_ceil(slack)),
+		  mask(capacity - 1),
+		  buf(capacity * channels)
+	{
+	}
+
+	SpscRingBuffer(const SpscRingBuffer &) = delete;
+	SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+	int get_channels() const { return channels; }
+
+	/**
+	 * Reallocate for a new slack and drop all buffered frames.
+	 * @note Neither the producer nor the consumer may be using the buffer during this call.
+	 */
+	void reset(const size_t slack)
+	{
+		capacity = std::bit_ceil(slack);
+		mask = capacity - 1;
+		buf.assign(capacity * channels, 0);
+		write_pos = read_pos = 0;
+		closed = false;
+	}
+
+	// producer: number of frames that can be written without blocking
+	size_t writable() const
+	{
+		return capacity - (write_pos.load(std::memory_order_relaxed) - read_pos.load(std::memory_order_acquire));
+	}
+
+	// consumer: number of frames that can be read
+	size_t readable() const
+	{
+		return write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_relaxed);
+	}
+
+	// total frames consumed so far, i.e. the playhead
+	size_t consumed() const
+	{
+		return read_pos.load(std::memory_order_acquire);
+	}
+
+	size_t underruns() const
+	{
+		return underrun_frames.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Producer: write up to `n_frames` frames.
+	 * @returns number of frames actually written
+	 */
+	size_t write(const float *const src, size_t n_frames)
+	{
+		n_frames = std::min(n_frames, writable());
+		const auto w = write_pos.load(std::memory_order_relaxed);
+		copy_in(w, src, n_frames);
+		write_pos.store(w + n_frames, std::memory_order_release);
+		return n_frames;
+	}
+
+	// producer: no more frames will be written, so running out from now on is the end of the stream, not an underrun
+	void close()
+	{
+		closed.store(true, std::memory_order_release);
+	}
+
+	/**
+	 * Consumer: read `n_frames` frames, filling with silence if fewer are available.
+	 * @returns number of frames actually read from the buffer
+	 */
+	size_t read(float *const dst, const size_t n_frames)
+	{
+		const auto r = read_pos.load(std::memory_order_relaxed);
+		const auto n = std::min(n_frames, readable());
+		copy_out(r, dst, n);
+		if (n < n_frames)
+		{
+			memset(dst + n * channels, 0, (n_frames - n) * channels * sizeof(float));
+			if (!closed.load(std::memory_order_relaxed))
+				underrun_frames.fetch_add(n_frames - n, std::memory_order_relaxed);
+		}
+		read_pos.store(r + n, std::memory_order_release);
+		return n;
+	}
+
+private:
+	void copy_in(const size_t pos, const float *const src, const size_t n_frames)
+	{
+		const auto start = pos & mask;
+		const auto first = std::min(n_frames, capacity - start);
+		memcpy(buf.data() + start * channels, src, first * channels * sizeof(float));
+		memcpy(buf.data(), src + first * channels, (n_frames - first) * channels * sizeof(float));
+	}
+
+	void copy_out(const size_t pos, float *const dst, const size_t n_frames) const
+	{
+		const auto start = pos & mask;
+		const auto first = std::min(n_frames, capacity - start);
+		memcpy(dst, buf.data() + start * channels, first * channels * sizeof(float));
+		memcpy(dst + first * channels, buf.data(), (n_frames - first) * channels * sizeof(float));
+	}
+};
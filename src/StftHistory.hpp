@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Sample history for short-time fourier analysis: the most recent frames of every channel,
+ * deinterleaved once as they are decoded rather than every time a window is read.
+ * Each channel is stored twice in a row, so any window ending within the history is one contiguous span
+ * that can be windowed straight into the fft input, however the hop between frames relates to the window size.
+ */
+class StftHistory
+{
+	int channels;
+
+	// frames kept per channel
+	size_t capacity;
+
+	// channel `c` is `2 * capacity` floats at `c * 2 * capacity`, the second half mirroring the first
+	std::vector<float> buf;
+
+	// total frames appended since construction or `reset`
+	uint64_t written = 0;
+
+public:
+	/**
+	 * @param channels number of channels of the interleaved frames appended
+	 * @param capacity most recent frames kept per channel
+	 */
+	StftHistory(const int channels, const size_t capacity)
+		: channels(channels)
+	{
+		reset(capacity);
+	}
+
+	/**
+	 * Reallocate for a new capacity and forget everything appended.
+	 */
+	void reset(const size_t capacity)
+	{
+		this->capacity = capacity;
+		buf.assign(2 * capacity * channels, 0);
+		written = 0;
+	}
+
+	size_t get_capacity() const { return capacity; }
+
+	// total frames appended, i.e. the frame the history ends at
+	uint64_t end() const { return written; }
+
+	/**
+	 * Append `n_frames` interleaved frames, dropping the oldest ones past the capacity.
+	 */
+	void append(const float *src, size_t n_frames)
+	{
+		if (n_frames > capacity)
+		{
+			src += (n_frames - capacity) * channels;
+			written += n_frames - capacity;
+			n_frames = capacity;
+		}
+		for (int ch = 0; ch < channels; ++ch)
+		{
+			float *const dst = buf.data() + ch * 2 * capacity;
+			size_t pos = written % capacity;
+			for (size_t i = 0; i < n_frames; ++i)
+			{
+				dst[pos] = dst[pos + capacity] = src[i * channels + ch];
+				if (++pos == capacity)
+					pos = 0;
+			}
+		}
+		written += n_frames;
+	}
+
+	/**
+	 * @param channel zero-based channel index
+	 * @param window_end frame the window ends at, at most `end()` and at least `end() - capacity + n_frames`
+	 * @param n_frames window length, at most the capacity
+	 * @returns the `n_frames` contiguous samples of `channel` ending at `window_end`.
+	 * frames from before the start of the stream read as silence
+	 */
+	const float *window(const int channel, const uint64_t window_end, const size_t n_frames) const
+	{
+		const auto start = (int64_t)window_end - (int64_t)n_frames;
+		const auto pos = ((start % (int64_t)capacity) + capacity) % capacity;
+		return buf.data() + channel * 2 * capacity + pos;
+	}
+};
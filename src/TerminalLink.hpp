@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <termios.h>
+#include <unistd.h>
+#include "ColorPalette.hpp"
+
+/**
+ * What the terminal on the other end of stdout can take: which color encodings it understands,
+ * and how many bytes per second actually get through to it. Over ssh or inside tmux, the link
+ * rather than the cpu is what limits the frame rate, and 24-bit color escapes are most of a frame.
+ */
+namespace TerminalLink
+{
+	// terminfo's `max_colors` numeric capability for `term`, or -1 if there is no compiled entry for it
+	int terminfo_max_colors(const std::string &term)
+	{
+		std::vector<std::filesystem::path> dirs;
+		if (const auto dir = getenv("TERMINFO"); dir && *dir)
+			dirs.emplace_back(dir);
+		if (const auto home = getenv("HOME"); home && *home)
+			dirs.emplace_back(std::filesystem::path(home) / ".terminfo");
+		if (const auto list = getenv("TERMINFO_DIRS"); list && *list)
+			for (std::string_view rest = list; !rest.empty();)
+			{
+				const auto colon = rest.find(':');
+				if (const auto dir = rest.substr(0, colon); !dir.empty())
+					dirs.emplace_back(dir);
+				rest = (colon == rest.npos) ? std::string_view() : rest.substr(colon + 1);
+			}
+		for (const auto dir : {"/etc/terminfo", "/lib/terminfo", "/usr/share/terminfo", "/usr/lib/terminfo"})
+			dirs.emplace_back(dir);
+
+		char hex[3];
+		snprintf(hex, sizeof(hex), "%02x", (unsigned char)term[0]);
+		for (const auto &dir : dirs)
+			// linux uses the first letter as the subdirectory, macos its hex code
+			for (const auto &sub : {std::string(1, term[0]), std::string(hex)})
+			{
+				std::ifstream file(dir / sub / term, std::ios::binary);
+				if (!file)
+					continue;
+				const std::vector<unsigned char> data{std::istreambuf_iterator<char>(file), {}};
+
+				// header: magic, then the sizes of the names, booleans, numbers, strings and string table
+				const auto u16 = [&](const size_t at) { return data[at] | data[at + 1] << 8; };
+				if (data.size() < 12)
+					return -1;
+				const auto magic = u16(0);
+				const int number_size = (magic == 01036) ? 4 : (magic == 0432) ? 2 : 0;
+				if (!number_size)
+					return -1;
+
+				// max_colors is the 14th number; numbers start aligned to 2 bytes after the names and booleans
+				constexpr int max_colors = 13;
+				if (u16(6) <= max_colors)
+					return -1;
+				size_t at = 12 + u16(2) + u16(4);
+				at += at & 1;
+				at += max_colors * number_size;
+				if (at + number_size > data.size())
+					return -1;
+				int32_t value;
+				if (number_size == 4)
+					value = data[at] | data[at + 1] << 8 | data[at + 2] << 16 | data[at + 3] << 24;
+				else
+					value = (int16_t)u16(at);
+				return value;
+			}
+		return -1;
+	}
+
+	/**
+	 * Deepest color encoding the terminal says it supports: truecolor if `COLORTERM` says so,
+	 * otherwise from terminfo's color count for `TERM`, otherwise from the name of `TERM`.
+	 */
+	ColorDepth supported_depth()
+	{
+		if (const auto colorterm = getenv("COLORTERM"); colorterm && (!strcmp(colorterm, "truecolor") || !strcmp(colorterm, "24bit")))
+			return ColorDepth::TRUECOLOR;
+		const auto term = getenv("TERM");
+		if (!term || !*term)
+			return ColorDepth::COLOR_16;
+		if (const auto colors = terminfo_max_colors(term); colors >= 0)
+			return (colors >= (1 << 24)) ? ColorDepth::TRUECOLOR : (colors >= 256) ? ColorDepth::COLOR_256 : ColorDepth::COLOR_16;
+		return strstr(term, "256color") ? ColorDepth::COLOR_256 : ColorDepth::COLOR_16;
+	}
+
+	/**
+	 * Measure how fast the terminal on `fd` consumes output, by writing `bytes` of invisible escapes
+	 * (attribute resets) and waiting until the terminal, or ssh/tmux in front of it, has read them all.
+	 * @returns bytes per second, or 0 if `fd` isn't a terminal or the measurement failed
+	 */
+	double probe(const int fd, const size_t bytes = 1 << 15)
+	{
+		if (!isatty(fd))
+			return 0;
+		std::string payload;
+		payload.reserve(bytes);
+		while (payload.size() + 4 <= bytes)
+			payload += "\e[0m";
+
+		const auto begin = std::chrono::steady_clock::now();
+		for (size_t written = 0; written < payload.size();)
+		{
+			const auto n = write(fd, payload.data() + written, payload.size() - written);
+			if (n < 0 && errno != EINTR)
+				return 0;
+			if (n > 0)
+				written += n;
+		}
+		if (tcdrain(fd) == -1)
+			return 0;
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+		return payload.size() / std::max(elapsed.count(), 1e-6);
+	}
+
+	/**
+	 * Rough bytes of a busy frame at `depth`: a quarter of the grid changes,
+	 * and every changed cell needs its own color escape, as with the color wheel.
+	 */
+	double frame_bytes(const ColorDepth depth, const int width, const int height)
+	{
+		// longest escape of each depth plus the glyph: "\e[9Xm", "\e[38;5;NNNm", "\e[38;2;RRR;GGG;BBBm"
+		const int cell_bytes = 1 + ((depth == ColorDepth::COLOR_16) ? 5 : (depth == ColorDepth::COLOR_256) ? 11 : 19);
+		return width * height / 4. * cell_bytes;
+	}
+
+	/**
+	 * Deepest color encoding, up to `max`, whose busy frames take at most half of the link at `fps`.
+	 * @param bandwidth bytes per second from `probe`, 0 if unknown, which picks `max`
+	 */
+	ColorDepth pick(const ColorDepth max, const double bandwidth, const int width, const int height, const double fps)
+	{
+		if (!bandwidth)
+			return max;
+		auto depth = max;
+		while (depth != ColorDepth::COLOR_16 && frame_bytes(depth, width, height) * fps > bandwidth / 2)
+			depth = (ColorDepth)((int)depth - 1);
+		return depth;
+	}
+}
+
+/**
+ * Watches how long frames spend blocked writing to the terminal while playing.
+ * Writes only block once the terminal's buffer is full, i.e. when the link can't keep up,
+ * so spending more than a quarter of the time in `write` means output has to shrink.
+ */
+class LinkMonitor
+{
+	using Clock = std::chrono::steady_clock;
+
+	// writes are judged over windows of this long
+	static constexpr std::chrono::seconds window{1};
+
+	Clock::time_point window_start = Clock::now();
+	Clock::duration blocked{};
+
+public:
+	/**
+	 * Record the time one frame spent writing.
+	 * @returns true at the end of a window in which the link was saturated
+	 */
+	bool saturated(const Clock::duration write_time)
+	{
+		blocked += write_time;
+		const auto now = Clock::now();
+		if (now - window_start < window)
+			return false;
+		const bool saturated = blocked * 4 > now - window_start;
+		window_start = now;
+		blocked = {};
+		return saturated;
+	}
+};
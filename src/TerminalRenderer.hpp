@@ -0,0 +1,393 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ColorPalette.hpp"
+#include "FrameBuffer.hpp"
+
+/**
+ * Double-buffered cell grid for drawing to the terminal.
+ * Each frame is drawn into the back grid, then `present` diffs it against
+ * the previous frame and encodes only the cells that changed.
+ */
+class TerminalRenderer
+{
+public:
+	// packed 0xRRGGBB, a `palette` color, or `DEFAULT_COLOR` for the terminal's default foreground
+	using Color = uint32_t;
+	static constexpr Color DEFAULT_COLOR = UINT32_MAX;
+
+	static constexpr Color rgb(const int r, const int g, const int b)
+	{
+		return (r << 16) | (g << 8) | b;
+	}
+
+	// color `index` of the terminal's 256 color palette, flagged above the 24 bits of rgb
+	static constexpr Color palette(const int index)
+	{
+		return PALETTE_FLAG | index;
+	}
+
+	struct Cell
+	{
+		char glyph = ' ';
+		Color color = DEFAULT_COLOR;
+		bool operator==(const Cell &) const = default;
+	};
+
+private:
+	static constexpr Color PALETTE_FLAG = 1 << 24;
+
+	int width = 0, height = 0;
+
+	// rgb colors are quantized to the palette as they are drawn when not `TRUECOLOR`,
+	// with one lookup in `nearest`, so cells that quantize the same aren't redrawn either
+	ColorDepth depth = ColorDepth::TRUECOLOR;
+	const ColorPalette::Table *nearest = nullptr;
+
+	// `front` is what the terminal currently shows, `back` is the frame being drawn
+	std::vector<Cell> front, back;
+
+	// set on the first frame and after a resize: clear the screen instead of diffing
+	bool full_redraw = true;
+
+	// terminal state while encoding; a cursor position of -1 means unknown
+	int cx = -1, cy = -1;
+	Color current_color = DEFAULT_COLOR;
+
+	// direct-mapped cache of ready-to-emit color escapes. a frame only uses a few hundred colors
+	// (one per column, shifting with the wheel), so nearly every color change is a single copy.
+	struct Escape
+	{
+		Color color = DEFAULT_COLOR;
+		uint8_t length = 0;
+		char bytes[23];
+	};
+	static constexpr int ESCAPE_CACHE_BITS = 10;
+	std::vector<Escape> escapes = std::vector<Escape>(1 << ESCAPE_CACHE_BITS);
+
+	// `draw_bars`' column colors, quantized once per frame
+	std::vector<Color> bar_colors;
+
+public:
+	TerminalRenderer(const int width, const int height)
+	{
+		resize(width, height);
+	}
+
+	/**
+	 * Resize both grids. The next `present` redraws the whole screen.
+	 * @param width new width in columns
+	 * @param height new height in rows
+	 */
+	void resize(const int width, const int height)
+	{
+		this->width = width;
+		this->height = height;
+		front.assign(width * height, {});
+		back.assign(width * height, {});
+		full_redraw = true;
+	}
+
+	int get_width() const { return width; }
+	int get_height() const { return height; }
+
+	/**
+	 * Set how colors are sent to the terminal. The next `present` redraws the whole screen.
+	 * @param depth `TRUECOLOR` for 24-bit escapes, or the 256 or 16 color palette, with each color mapped to its nearest entry
+	 */
+	void set_color_depth(const ColorDepth depth)
+	{
+		if (depth == this->depth)
+			return;
+		this->depth = depth;
+		nearest = (depth == ColorDepth::TRUECOLOR) ? nullptr : &ColorPalette::nearest(depth);
+		full_redraw = true;
+	}
+
+	ColorDepth get_color_depth() const { return depth; }
+
+	/**
+	 * Blank out the back grid before drawing a new frame.
+	 */
+	void clear()
+	{
+		std::ranges::fill(back, Cell{});
+	}
+
+	/**
+	 * Set a cell of the back grid. Blank glyphs are stored without a color,
+	 * since a space looks the same in any foreground color.
+	 */
+	void set(const int x, const int y, const char glyph, const Color color)
+	{
+		back[y * width + x] = (glyph == ' ') ? Cell{} : Cell{glyph, quantize(color)};
+	}
+
+	/**
+	 * Overwrite the whole back grid with one bar per column, growing upwards from the bottom row.
+	 * The grid is filled a row at a time, left to right, in the order `present` reads it.
+	 * @param bar_heights height of each column's bar in rows, `get_width()` long. clamped to the grid height
+	 * @param colors color of each column's bar, `get_width()` long
+	 * @param characters characters to draw (in order) going upwards
+	 * @param peak_char character to draw at the top of each bar, or 0 to keep using `characters`
+	 */
+	void draw_bars(const std::vector<int> &bar_heights, const std::vector<Color> &colors, const std::string &characters, const char peak_char)
+	{
+		bar_colors.resize(width);
+		for (int x = 0; x < width; ++x)
+			bar_colors[x] = quantize(colors[x]);
+
+		for (int y = 0; y < height; ++y)
+		{
+			// rows above the bottom one
+			const int j = height - 1 - y;
+			const auto glyph = characters[j % characters.length()];
+			const auto row = &back[y * width];
+			for (int x = 0; x < width; ++x)
+			{
+				const auto bar_height = std::min(bar_heights[x], height);
+				const auto g = (j >= bar_height) ? ' ' : (peak_char && j == bar_height - 1) ? peak_char : glyph;
+				row[x] = (g == ' ') ? Cell{} : Cell{g, bar_colors[x]};
+			}
+		}
+	}
+
+	/**
+	 * Draw a line of text starting at (`x`, `y`), cut off at the right edge of the grid.
+	 * @param x starting column
+	 * @param y row to draw in
+	 * @param text text to draw
+	 * @param color color of the text
+	 */
+	void draw_text(const int x, const int y, const std::string_view text, const Color color)
+	{
+		if (y < 0 || y >= height)
+			return;
+		for (int i = 0; i < (int)text.size() && x + i < width; ++i)
+			set(x + i, y, text[i], color);
+	}
+
+	/**
+	 * Encode the differences between the back grid and what is on screen,
+	 * then make the back grid the new front.
+	 * @param out buffer to append the escape sequences to
+	 */
+	void present(FrameBuffer &out)
+	{
+		if (full_redraw)
+		{
+			out.append("\e[0m\e[H\e[2J");
+			std::ranges::fill(front, Cell{});
+			current_color = DEFAULT_COLOR;
+			cx = cy = 0;
+			full_redraw = false;
+		}
+
+		// each row is encoded left to right as one run, with cursor moves only over unchanged cells
+		for (int y = 0; y < height; ++y)
+		{
+			const auto row = &back[y * width], old_row = &front[y * width];
+			if (std::equal(row, row + width, old_row))
+				continue;
+
+			// blank from `blank_from` to the end of the row: erase it with one escape
+			// instead of overwriting every cell that was cleared, if that is shorter
+			int blank_from = width;
+			while (blank_from && row[blank_from - 1].glyph == ' ')
+				--blank_from;
+			const auto cleared = std::count_if(old_row + blank_from, old_row + width, [](const Cell &c) { return c.glyph != ' '; });
+			const bool erase = cleared > erase_cost;
+			const int end = erase ? blank_from : width;
+
+			for (int x = 0; x < end; ++x)
+			{
+				const auto &cell = row[x];
+				if (cell == old_row[x])
+					continue;
+				move_cursor(out, x, y);
+				if (cell.glyph != ' ' && cell.color != current_color)
+					set_color(out, cell.color);
+				out.append(cell.glyph);
+
+				// the cursor stays put after writing to the last column (pending wrap),
+				// so don't make assumptions about where it is
+				if (++cx == width)
+					cx = cy = -1;
+			}
+
+			if (erase)
+			{
+				move_cursor(out, blank_from, y);
+				out.append("\e[K");
+			}
+		}
+
+		front.swap(back);
+	}
+
+private:
+	// bytes of "\e[K", erase to the end of the line
+	static constexpr int erase_cost = 3;
+
+	Color quantize(const Color color) const
+	{
+		if (!nearest || color == DEFAULT_COLOR || (color & PALETTE_FLAG))
+			return color;
+		return palette((*nearest)[ColorPalette::key(color)]);
+	}
+
+	static int digits(int n)
+	{
+		int d = 1;
+		while (n >= 10)
+			n /= 10, ++d;
+		return d;
+	}
+
+	// cost in bytes of moving `n` cells with a relative cursor movement, 0 if `n` is 0
+	static int relative_cost(const int n)
+	{
+		if (!n)
+			return 0;
+		const int a = std::abs(n);
+		return (a == 1) ? 3 : (3 + digits(a));
+	}
+
+	static void append_relative(FrameBuffer &out, const int n, const char positive, const char negative)
+	{
+		if (!n)
+			return;
+		out.append("\e[");
+		if (std::abs(n) != 1)
+			out.append_uint(std::abs(n));
+		out.append((n > 0) ? positive : negative);
+	}
+
+	// whether the cells between the cursor and `x` on the cursor's row can be rewritten
+	// as-is (they are unchanged on screen) without a color change
+	bool can_overprint(const int x) const
+	{
+		for (int i = cx; i < x; ++i)
+		{
+			const auto &cell = back[cy * width + i];
+			if (cell.glyph != ' ' && cell.color != current_color)
+				return false;
+		}
+		return true;
+	}
+
+	// move the cursor to (x, y) with the shortest encoding available
+	void move_cursor(FrameBuffer &out, const int x, const int y)
+	{
+		if (cx == x && cy == y)
+			return;
+
+		const int absolute_cost = 4 + digits(y + 1) + digits(x + 1);
+		int best_cost = absolute_cost;
+		enum { ABSOLUTE, RELATIVE, CARRIAGE_RETURN, OVERPRINT } best = ABSOLUTE;
+
+		if (cx >= 0)
+		{
+			const int vertical = relative_cost(y - cy);
+			if (const int cost = vertical + relative_cost(x - cx); cost < best_cost)
+				best_cost = cost, best = RELATIVE;
+			if (const int cost = vertical + 1 + relative_cost(x); cx && cost < best_cost)
+				best_cost = cost, best = CARRIAGE_RETURN;
+			if (y == cy && x > cx && x - cx < best_cost && can_overprint(x))
+				best = OVERPRINT;
+		}
+
+		switch (best)
+		{
+		case ABSOLUTE:
+			out.append("\e[");
+			out.append_uint(y + 1);
+			out.append(';');
+			out.append_uint(x + 1);
+			out.append('H');
+			break;
+		case RELATIVE:
+			append_relative(out, y - cy, 'B', 'A');
+			append_relative(out, x - cx, 'C', 'D');
+			break;
+		case CARRIAGE_RETURN:
+			append_relative(out, y - cy, 'B', 'A');
+			out.append('\r');
+			append_relative(out, x, 'C', 'D');
+			break;
+		case OVERPRINT:
+			for (int i = cx; i < x; ++i)
+				out.append(back[cy * width + i].glyph);
+			break;
+		}
+
+		cx = x;
+		cy = y;
+	}
+
+	void set_color(FrameBuffer &out, const Color color)
+	{
+		auto &escape = escapes[(color * 2654435761u) >> (32 - ESCAPE_CACHE_BITS)];
+		if (escape.color != color || !escape.length)
+		{
+			escape.color = color;
+			escape.length = encode_color(escape.bytes, color);
+		}
+		out.append(escape.bytes, escape.length);
+		current_color = color;
+	}
+
+	// write the escape selecting `color` to `p`, returning its length
+	static int encode_color(char *p, const Color color)
+	{
+		const auto begin = p;
+		const auto append_uint = [&](const unsigned n)
+		{
+			if (n >= 100)
+				*p++ = '0' + n / 100;
+			if (n >= 10)
+				*p++ = '0' + n / 10 % 10;
+			*p++ = '0' + n % 10;
+		};
+		const auto append = [&](const std::string_view s)
+		{
+			p = std::ranges::copy(s, p).out;
+		};
+
+		if (color == DEFAULT_COLOR)
+			append("\e[39m");
+		else if (color & PALETTE_FLAG)
+		{
+			// the 16 system colors have short escapes of their own
+			const int index = color & 0xff;
+			if (index < 16)
+			{
+				append((index < 8) ? "\e[3" : "\e[9");
+				*p++ = '0' + index % 8;
+			}
+			else
+			{
+				append("\e[38;5;");
+				append_uint(index);
+			}
+			*p++ = 'm';
+		}
+		else
+		{
+			append("\e[38;2;");
+			append_uint((color >> 16) & 0xff);
+			*p++ = ';';
+			append_uint((color >> 8) & 0xff);
+			*p++ = ';';
+			append_uint(color & 0xff);
+			*p++ = 'm';
+		}
+		return p - begin;
+	}
+};
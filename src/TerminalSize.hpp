@@ -1,5 +1,11 @@
 #pragma once
 
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <signal.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
@@ -7,12 +13,78 @@ struct TerminalSize
 {
 	int width, height;
 
+	// size of the terminal on stdout
 	TerminalSize()
+	{
+		if (!query())
+			throw std::runtime_error(std::string("ioctl: ") + strerror(errno));
+	}
+
+	// size of the terminal on stdout, or `width` x `height` if stdout isn't a terminal
+	TerminalSize(const int width, const int height)
+	{
+		if (!query())
+			this->width = width, this->height = height;
+	}
+
+private:
+	bool query()
 	{
 		winsize ws;
 		if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1)
-			throw std::runtime_error(std::string("ioctl: ") + strerror(errno));
+			return false;
 		width = ws.ws_col;
 		height = ws.ws_row;
+		return true;
+	}
+};
+
+/**
+ * Notices terminal resizes from `SIGWINCH`, so the size is only queried after the terminal actually changed
+ * instead of with an ioctl every frame. The handler just sets a flag, so checking for a resize is one load.
+ * Only one should exist at a time; the previous handler is restored when it is destroyed.
+ */
+class ResizeSignal
+{
+	static_assert(std::atomic<bool>::is_always_lock_free, "the flag is set from a signal handler");
+	static inline std::atomic<bool> resized = false;
+
+	struct sigaction previous;
+
+public:
+	/**
+	 * Install the `SIGWINCH` handler.
+	 * @throws `std::runtime_error` if it can't be installed
+	 */
+	ResizeSignal()
+	{
+		resized.store(false, std::memory_order_relaxed);
+		struct sigaction action{};
+		action.sa_handler = handle;
+		// restart interrupted writes to the terminal instead of failing them
+		action.sa_flags = SA_RESTART;
+		sigemptyset(&action.sa_mask);
+		if (sigaction(SIGWINCH, &action, &previous) == -1)
+			throw std::runtime_error(std::string("sigaction: ") + strerror(errno));
+	}
+
+	~ResizeSignal()
+	{
+		sigaction(SIGWINCH, &previous, nullptr);
+	}
+
+	ResizeSignal(const ResizeSignal &) = delete;
+	ResizeSignal &operator=(const ResizeSignal &) = delete;
+
+	// whether the terminal was resized since the last call
+	bool take()
+	{
+		return resized.exchange(false, std::memory_order_acquire);
+	}
+
+private:
+	static void handle(int)
+	{
+		resized.store(true, std::memory_order_release);
 	}
-};
\ No newline at end of file
+};
@@ -0,0 +1,421 @@
+// termviz-bench: runs synthetic audio through the spectrum and terminal rendering pipeline
+// without an audio device or a terminal, and reports how long each stage takes per frame.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <argparse/argparse.hpp>
+#include "ColorUtils.hpp"
+#include "FrameBuffer.hpp"
+#include "FrameStats.hpp"
+#include "FrequencySpectrum.hpp"
+#include "SpectrumDrawer.hpp"
+#include "TerminalRenderer.hpp"
+#include "fftwf_dft_r2c_1d.hpp"
+
+using argparse::ArgumentParser;
+using Scale = FrequencySpectrum::Scale;
+using InterpType = FrequencySpectrum::InterpType;
+using ColorType = SpectrumDrawer::ColorType;
+
+// same rates as termviz uses for playback
+constexpr int sample_rate = 44100, refresh_rate = 60;
+constexpr int hop = sample_rate / refresh_rate;
+
+// stages a bench frame goes through, in pipeline order
+constexpr FrameStats::Stage stages[]{
+	FrameStats::COPY, FrameStats::WINDOW, FrameStats::FFT, FrameStats::BINS,
+	FrameStats::INTERP, FrameStats::DRAW, FrameStats::ENCODE, FrameStats::WRITE};
+
+struct Case
+{
+	std::string signal;
+	int fft_size, width, height;
+	std::string scale, interp, color;
+};
+
+std::vector<std::string> split(const std::string &list)
+{
+	std::vector<std::string> items;
+	std::istringstream ss(list);
+	for (std::string item; std::getline(ss, item, ',');)
+		if (!item.empty())
+			items.push_back(item);
+	return items;
+}
+
+std::vector<int> split_ints(const std::string &list)
+{
+	std::vector<int> ints;
+	for (const auto &item : split(list))
+		ints.push_back(std::stoi(item));
+	return ints;
+}
+
+/**
+ * Generate `length` mono samples of a synthetic test signal. Noise uses a fixed seed, so runs are comparable.
+ * @param name one of `sweep`, `white`, `pink`, `silence`, `square`
+ * @throws `std::invalid_argument` if `name` is unknown
+ */
+std::vector<float> make_signal(const std::string &name, const size_t length)
+{
+	std::vector<float> s(length);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> noise(-1, 1);
+
+	if (name == "sweep")
+	{
+		// exponential sine sweep from 20 Hz to 20 kHz over the whole signal
+		const double f0 = 20, f1 = 20000, duration = (double)length / sample_rate;
+		const double k = log(f1 / f0);
+		for (size_t i = 0; i < length; ++i)
+		{
+			const double t = (double)i / sample_rate;
+			s[i] = 0.8 * sin(2 * M_PI * f0 * duration / k * (exp(t / duration * k) - 1));
+		}
+	}
+	else if (name == "white")
+		for (auto &x : s)
+			x = 0.5f * noise(rng);
+	else if (name == "pink")
+	{
+		// paul kellet's economy pink noise filter
+		float b0 = 0, b1 = 0, b2 = 0;
+		for (auto &x : s)
+		{
+			const float white = noise(rng);
+			b0 = 0.99765f * b0 + white * 0.0990460f;
+			b1 = 0.96300f * b1 + white * 0.2965164f;
+			b2 = 0.57000f * b2 + white * 1.0526913f;
+			x = 0.15f * (b0 + b1 + b2 + white * 0.1848f);
+		}
+	}
+	else if (name == "silence")
+		; // already zeroed
+	else if (name == "square")
+		// a 220 Hz sine driven hard into clipping
+		for (size_t i = 0; i < length; ++i)
+			s[i] = 0.9f * std::clamp(4 * sin(2 * M_PI * 220 * i / sample_rate), -1., 1.);
+	else
+		throw std::invalid_argument("unknown signal: " + name);
+
+	return s;
+}
+
+Scale parse_scale(const std::string &s)
+{
+	if (s == "linear")
+		return Scale::LINEAR;
+	if (s == "log")
+		return Scale::LOG;
+	if (s == "nth-root")
+		return Scale::NTH_ROOT;
+	throw std::invalid_argument("unknown scale: " + s);
+}
+
+InterpType parse_interp(const std::string &s)
+{
+	if (s == "none")
+		return InterpType::NONE;
+	if (s == "linear")
+		return InterpType::LINEAR;
+	if (s == "cspline")
+		return InterpType::CSPLINE;
+	if (s == "cspline_hermite")
+		return InterpType::CSPLINE_HERMITE;
+	throw std::invalid_argument("unknown interpolation type: " + s);
+}
+
+ColorType parse_color(const std::string &s)
+{
+	if (s == "wheel")
+		return ColorType::WHEEL;
+	if (s == "solid")
+		return ColorType::SOLID;
+	if (s == "gradient")
+		return ColorType::GRADIENT;
+	if (s == "none")
+		return ColorType::NONE;
+	throw std::invalid_argument("unknown color type: " + s);
+}
+
+// the gradient benched with `--colors gradient`: red, yellow, cyan, blue, blended in linear-light rgb
+ColorUtils::Gradient bench_gradient()
+{
+	using Gradient = ColorUtils::Gradient;
+	return Gradient(Gradient::Space::RGB, {{0, 1, 0, 0}, {1 / 3.f, 1, 1, 0}, {2 / 3.f, 0, 1, 1}, {1, 0, 0, 1}});
+}
+
+SpectrumKernels::Isa parse_isa(const std::string &s)
+{
+	if (s == "scalar")
+		return SpectrumKernels::Isa::SCALAR;
+	if (s == "sse2")
+		return SpectrumKernels::Isa::SSE2;
+	if (s == "avx2")
+		return SpectrumKernels::Isa::AVX2;
+	if (s == "avx512")
+		return SpectrumKernels::Isa::AVX512;
+	throw std::invalid_argument("unknown instruction set: " + s);
+}
+
+// offsets of the bin range of each of `width` columns, spread over `bins` bins linearly or logarithmically like `FrequencySpectrum`
+std::vector<int> bin_offsets(const int bins, const int width, const bool logarithmic)
+{
+	std::vector<int> offsets(width + 1);
+	for (int i = 0; i < bins; ++i)
+	{
+		const auto ratio = logarithmic ? (std::log(i ? i : 1) / std::log(bins - 1)) : ((float)i / (bins - 1));
+		++offsets[std::clamp((int)(ratio * width), 0, width - 1) + 1];
+	}
+	for (int c = 0; c < width; ++c)
+		offsets[c + 1] += offsets[c];
+	return offsets;
+}
+
+/**
+ * Run the kernels of every supported instruction set on `frames` spectra of `signal`,
+ * and compare each output byte for byte with the scalar kernels' output, printing every mismatch.
+ * Bins are reduced into `width` columns with both a linear and a logarithmic bin map,
+ * so ranges of every length are covered, empty ones included.
+ * @returns number of mismatching outputs
+ */
+int verify_kernels(const std::string &signal_name, const std::vector<float> &signal, const int fft_size, const int width, const int frames)
+{
+	const auto &scalar = SpectrumKernels::get(SpectrumKernels::Isa::SCALAR);
+	std::vector<const SpectrumKernels::Kernels *> others;
+	for (const auto isa : {SpectrumKernels::Isa::SSE2, SpectrumKernels::Isa::AVX2, SpectrumKernels::Isa::AVX512})
+		if (SpectrumKernels::supported(isa))
+			others.push_back(&SpectrumKernels::get(isa));
+
+	fftwf_dft_r2c_1d fft(fft_size);
+	const auto bins = fft.get_output_size();
+	const std::vector<int> maps[]{bin_offsets(bins, width, false), bin_offsets(bins, width, true)};
+	// outputs hold either every bin or every column
+	std::vector<float> magnitudes(bins), expected(std::max(bins, width)), actual(expected.size());
+
+	int mismatches = 0;
+	const auto compare = [&](const SpectrumKernels::Kernels &k, const char *const kernel, const int frame, const size_t n)
+	{
+		if (!memcmp(expected.data(), actual.data(), n * sizeof(float)))
+			return;
+		std::printf("%s %s differs from scalar: %s, n %d, w %d, frame %d\n", k.name, kernel, signal_name.c_str(), fft_size, width, frame);
+		++mismatches;
+	};
+
+	for (int f = 0; f < frames; ++f)
+	{
+		const auto window = signal.data() + (size_t)f * hop;
+		std::copy(window, window + fft_size, fft.get_input());
+		fft.execute();
+
+		scalar.magnitudes(fft.get_output(), magnitudes.data(), bins);
+		std::ranges::copy(magnitudes, expected.begin());
+		for (const auto k : others)
+		{
+			k->magnitudes(fft.get_output(), actual.data(), bins);
+			compare(*k, "magnitudes", f, bins);
+		}
+
+		// every version reduces the same magnitudes, so only the reduction is compared
+		for (const auto &offsets : maps)
+		{
+			scalar.reduce_sum(magnitudes.data(), offsets.data(), expected.data(), width);
+			for (const auto k : others)
+			{
+				k->reduce_sum(magnitudes.data(), offsets.data(), actual.data(), width);
+				compare(*k, "reduce_sum", f, width);
+			}
+			scalar.reduce_max(magnitudes.data(), offsets.data(), expected.data(), width);
+			for (const auto k : others)
+			{
+				k->reduce_max(magnitudes.data(), offsets.data(), actual.data(), width);
+				compare(*k, "reduce_max", f, width);
+			}
+		}
+	}
+	return mismatches;
+}
+
+/**
+ * Render `frames` frames of one case into `sink` and print its row of the results table.
+ * `warmup` frames are rendered first and not measured, so one-time work
+ * (bin map, interpolator layout, the renderer's initial full redraw) doesn't skew the averages.
+ */
+void run_case(const Case &c, const std::vector<float> &signal, const int frames, const int warmup,
+			  const float wheel_rate, const SpectrumKernels::Kernels &kernels, const int sink)
+{
+	FrequencySpectrum fs(c.fft_size);
+	fs.set_scale(parse_scale(c.scale))
+		.set_interp_type(parse_interp(c.interp))
+		.set_kernel_isa(kernels.isa);
+
+	SpectrumDrawer drawer;
+	drawer.set_color_type(parse_color(c.color))
+		.set_wheel_rate(wheel_rate);
+	if (c.color == "gradient")
+		drawer.set_gradient(bench_gradient());
+
+	TerminalRenderer renderer(c.width, c.height);
+	FrameBuffer out;
+	std::vector<std::vector<float>> spectra(1, std::vector<float>(c.width));
+
+	FrameStats stats;
+	fs.set_stats(&stats);
+	FrameBuffer::Counters before{};
+
+	for (int f = 0; f < warmup + frames; ++f)
+	{
+		if (f == warmup)
+		{
+			stats = {};
+			before = out.all_frames();
+		}
+
+		const FrameStats::Timer frame_timer(&stats, FrameStats::FRAME);
+		{
+			const FrameStats::Timer t(&stats, FrameStats::COPY);
+			const auto window = signal.data() + (size_t)f * hop;
+			std::copy(window, window + c.fft_size, fs.input_array());
+		}
+		fs.render(spectra);
+		{
+			const FrameStats::Timer t(&stats, FrameStats::DRAW);
+			drawer.draw(renderer, spectra);
+			drawer.advance_wheel();
+		}
+		{
+			const FrameStats::Timer t(&stats, FrameStats::ENCODE);
+			renderer.present(out);
+		}
+		{
+			const FrameStats::Timer t(&stats, FrameStats::WRITE);
+			out.flush(sink);
+		}
+	}
+
+	std::printf("%-8s %6d %5d %4d %-8s %-15s %-8s", c.signal.c_str(), c.fft_size, c.width, c.height,
+				c.scale.c_str(), c.interp.c_str(), c.color.c_str());
+	for (const auto stage : stages)
+		std::printf(" %8lu", (unsigned long)stats[stage].mean());
+	const auto &frame = stats[FrameStats::FRAME];
+	std::printf(" %9lu %9lu %9.0f %8zu\n", (unsigned long)frame.mean(), (unsigned long)frame.percentile(99),
+				1e9 / frame.mean(), (out.all_frames().bytes - before.bytes) / frames);
+}
+
+int main(const int argc, const char *const *const argv)
+{
+	ArgumentParser args(argv[0]);
+	args.add_description("benchmark the spectrum and terminal rendering pipeline with synthetic audio.\nevery list is comma separated, and every combination of them is run.");
+
+	args.add_argument("--signals")
+		.help("test signals: sweep, white, pink, silence, square")
+		.default_value(std::string("sweep,white,pink,silence,square"));
+	args.add_argument("-n", "--sample-sizes")
+		.help("fft sizes")
+		.default_value(std::string("3000"));
+	args.add_argument("--widths")
+		.help("terminal widths")
+		.default_value(std::string("80,240"));
+	args.add_argument("--heights")
+		.help("terminal heights")
+		.default_value(std::string("24,60"));
+	args.add_argument("-s", "--scales")
+		.help("frequency scales: linear, log, nth-root")
+		.default_value(std::string("log"));
+	args.add_argument("-i", "--interpolations")
+		.help("interpolation types: none, linear, cspline, cspline_hermite")
+		.default_value(std::string("cspline"));
+	args.add_argument("--colors")
+		.help("color types: wheel, solid, gradient, none")
+		.default_value(std::string("wheel,none"));
+	args.add_argument("--wheel-rate")
+		.help("color wheel rotation per frame, so the wheel exercises the renderer's diffing like during playback")
+		.default_value(0.005f)
+		.scan<'f', float>();
+	args.add_argument("--frames")
+		.help("measured frames per case")
+		.default_value(600)
+		.scan<'i', int>();
+	args.add_argument("--warmup")
+		.help("unmeasured frames rendered before each case")
+		.default_value(30)
+		.scan<'i', int>();
+	args.add_argument("--isa")
+		.help("instruction set for the magnitude/reduction kernels: scalar, sse2, avx2, avx512\ndefaults to the widest one supported");
+	args.add_argument("--verify")
+		.help("instead of timing anything, check that every supported instruction set's kernels give exactly the scalar kernels' output\non --frames spectra of every signal, sample size and width. exits with failure on any difference")
+		.flag();
+
+	try
+	{
+		args.parse_args(argc, argv);
+
+		const auto frames = args.get<int>("--frames"), warmup = args.get<int>("--warmup");
+		if (frames <= 0 || warmup < 0)
+			throw std::invalid_argument("--frames must be positive and --warmup can't be negative");
+
+		const auto &kernels = args.present("--isa")
+								  ? SpectrumKernels::get(parse_isa(args.get("--isa")))
+								  : SpectrumKernels::best();
+
+		// discard sink: still pays for the write syscalls, but not for a terminal parsing the output
+		const int sink = open("/dev/null", O_WRONLY);
+		if (sink < 0)
+			throw std::runtime_error(std::string("open /dev/null: ") + strerror(errno));
+
+		const auto sizes = split_ints(args.get("-n"));
+		for (const auto n : sizes)
+			if (n <= 0 || n & 1)
+				throw std::invalid_argument("sample sizes must be positive and even!");
+		const auto max_size = *std::ranges::max_element(sizes);
+
+		if (args.get<bool>("--verify"))
+		{
+			int mismatches = 0, cases = 0;
+			for (const auto &signal_name : split(args.get("--signals")))
+			{
+				const auto signal = make_signal(signal_name, max_size + (size_t)frames * hop);
+				for (const auto n : sizes)
+					for (const auto w : split_ints(args.get("--widths")))
+					{
+						mismatches += verify_kernels(signal_name, signal, n, w, frames);
+						++cases;
+					}
+			}
+			std::printf("%d cases of %d frames: %d outputs differ from the scalar kernels\n", cases, frames, mismatches);
+			close(sink);
+			return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+		}
+
+		std::printf("kernels: %s, %d frames per case, hop %d samples at %d Hz\n", kernels.name, frames, hop, sample_rate);
+		std::printf("%-8s %6s %5s %4s %-8s %-15s %-8s", "signal", "n", "w", "h", "scale", "interp", "color");
+		for (const auto stage : stages)
+			std::printf(" %8s", FrameStats::stage_names[stage]);
+		std::printf(" %9s %9s %9s %8s\n", "ns/frame", "p99 ns", "frames/s", "B/frame");
+
+		for (const auto &signal_name : split(args.get("--signals")))
+		{
+			const auto signal = make_signal(signal_name, max_size + (size_t)(warmup + frames) * hop);
+			for (const auto n : sizes)
+				for (const auto w : split_ints(args.get("--widths")))
+					for (const auto h : split_ints(args.get("--heights")))
+						for (const auto &scale : split(args.get("-s")))
+							for (const auto &interp : split(args.get("-i")))
+								for (const auto &color : split(args.get("--colors")))
+									run_case({signal_name, n, w, h, scale, interp, color}, signal, frames, warmup,
+											 args.get<float>("--wheel-rate"), kernels, sink);
+		}
+
+		close(sink);
+	}
+	catch (const std::exception &e)
+	{
+		std::cerr << argv[0] << ": " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+}
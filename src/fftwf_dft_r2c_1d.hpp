@@ -1,22 +1,37 @@
 #pragma once
 
+#include <string>
 #include <fftw3.h>
 
+// one or more (`howmany`) real-to-complex 1d transforms of size N, executed as a single batched plan.
+// input and output are channel-major: transform `h` reads `in + h * N` and writes `out + h * (N / 2 + 1)`.
 class fftwf_dft_r2c_1d
 {
 	int N;
+	int howmany;
 	float *in;
 	int output_size;
 	fftwf_complex *out;
 	fftwf_plan p;
 
-	void init(const int N)
+	// fftw planner flags, e.g. `FFTW_ESTIMATE` or `FFTW_MEASURE`
+	unsigned flags = FFTW_ESTIMATE;
+
+	void init(const int N, const int howmany)
 	{
 		this->N = N;
-		in = (float *)fftwf_malloc(sizeof(float) * N);
+		this->howmany = howmany;
+		in = (float *)fftwf_malloc(sizeof(float) * N * howmany);
 		output_size = N / 2 + 1;
-		out = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * output_size);
-		p = fftwf_plan_dft_r2c_1d(N, in, out, FFTW_ESTIMATE);
+		out = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * output_size * howmany);
+
+		// estimated plans are cheap enough to not bother with wisdom
+		const bool use_wisdom = !wisdom_file.empty() && !(flags & FFTW_ESTIMATE);
+		if (use_wisdom)
+			load_wisdom();
+		p = fftwf_plan_many_dft_r2c(1, &N, howmany, in, NULL, 1, N, out, NULL, 1, output_size, flags);
+		if (use_wisdom)
+			fftwf_export_wisdom_to_filename(wisdom_file.c_str());
 	}
 
 	void cleanup()
@@ -26,16 +41,58 @@ class fftwf_dft_r2c_1d
 		fftwf_free(out);
 	}
 
+	// import `wisdom_file` once per process; a missing file is not an error
+	static void load_wisdom()
+	{
+		static bool loaded = false;
+		if (loaded)
+			return;
+		fftwf_import_wisdom_from_filename(wisdom_file.c_str());
+		loaded = true;
+	}
+
 public:
-	fftwf_dft_r2c_1d(const int N) { init(N); }
+	/**
+	 * File to persist fftw wisdom in, so measured plans are only paid for once per machine and size.
+	 * Loaded before the first non-estimated plan and saved after every one. Empty disables wisdom.
+	 */
+	inline static std::string wisdom_file;
+
+	fftwf_dft_r2c_1d(const int N, const int howmany = 1) { init(N, howmany); }
 	~fftwf_dft_r2c_1d() { cleanup(); }
 
+	// plans its own buffers of the same size; the input is not copied
+	fftwf_dft_r2c_1d(const fftwf_dft_r2c_1d &other) : flags(other.flags) { init(other.N, other.howmany); }
+	fftwf_dft_r2c_1d &operator=(const fftwf_dft_r2c_1d &) = delete;
+
 	void set_n(const int N)
 	{
 		if (this->N == N)
 			return;
 		cleanup();
-		init(N);
+		init(N, howmany);
+	}
+
+	void set_howmany(const int howmany)
+	{
+		if (this->howmany == howmany)
+			return;
+		cleanup();
+		init(N, howmany);
+	}
+
+	/**
+	 * Set the planner flags and re-plan if they changed.
+	 * @note Planning with anything other than `FFTW_ESTIMATE` overwrites the input array.
+	 * @param flags new planner flags to use
+	 */
+	void set_flags(const unsigned flags)
+	{
+		if (this->flags == flags)
+			return;
+		this->flags = flags;
+		cleanup();
+		init(N, howmany);
 	}
 
 	void execute()
@@ -53,8 +110,14 @@ public:
 		return out;
 	}
 
+	// size of a single transform's output
 	int get_output_size() const
 	{
 		return output_size;
 	}
-};
\ No newline at end of file
+
+	int get_howmany() const
+	{
+		return howmany;
+	}
+};
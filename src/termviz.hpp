@@ -1,27 +1,43 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
 #include <cstring>
+#include <fstream>
+#include <memory>
 #include <mutex>
+#include <thread>
 #include <sndfile.hh>
-#include "ColorUtils.hpp"
+#include "AudioSink.hpp"
+#include "CacheDir.hpp"
+#include "FrameBuffer.hpp"
+#include "FrameScheduler.hpp"
+#include "FrameStats.hpp"
 #include "FrequencySpectrum.hpp"
-#include "PortAudio.hpp"
+#include "OfflineRenderer.hpp"
+#include "PcmCache.hpp"
+#include "PcmPipe.hpp"
+#include "SpectrumCache.hpp"
+#include "SpectrumDrawer.hpp"
+#include "SpectrumPrefetcher.hpp"
+#include "SpscRingBuffer.hpp"
+#include "StftHistory.hpp"
+#include "TerminalLink.hpp"
+#include "TerminalRenderer.hpp"
 #include "TerminalSize.hpp"
 
 class termviz
 {
 public:
-	enum class ColorType
-	{
-		NONE,
-		WHEEL,
-		SOLID
-	};
-
+	using ColorType = SpectrumDrawer::ColorType;
 	using Scale = FrequencySpectrum::Scale;
 	using InterpType = FrequencySpectrum::InterpType;
 	using AccumulationMethod = FrequencySpectrum::AccumulationMethod;
 	using WindowFunction = FrequencySpectrum::WindowFunction;
+	using PlannerRigor = FrequencySpectrum::PlannerRigor;
+	using RenderFormat = OfflineRenderer::Format;
+	using GradientSpace = ColorUtils::Gradient::Space;
 
 private:
 	// in case multiple threads use this object!
@@ -31,118 +47,308 @@ private:
 	int sample_size = 3000;
 
 	// audio file
+	std::string audio_file;
 	SndfileHandle sf;
 
+	// raw pcm from stdin instead of `audio_file`, never seeked. null when playing a file
+	std::unique_ptr<PcmPipe> pipe;
+
+	// of whichever of the two is playing
+	int channels, samplerate;
+
+	// picks the video frame to show from the audio clock, at 60 fps unless set otherwise
+	FrameScheduler scheduler{samplerate, 60};
+
+	// where playback is according to the audio device, updated by `sink`'s callback
+	AudioClock clock;
+
 	// clean spectrum generator
 	FrequencySpectrum fs;
 
-	// terminal width and height
-	TerminalSize tsize;
-	// bool stereo = (sf.channels() == 2);
-	bool stereo = false;
-	bool mirrored = false;
+	// terminal width and height, 80x24 if stdout isn't a terminal (when rendering to a file)
+	TerminalSize tsize{80, 24};
+
+	// keeps the previous frame to only redraw what changed
+	TerminalRenderer renderer = TerminalRenderer(tsize.width, tsize.height);
+
+	// each frame is encoded here and written with one syscall
+	FrameBuffer out;
+
+	// pick the renderer's color depth from what the terminal supports and how fast output gets through to it,
+	// and lower it while playing if writes start blocking. false when set with `set_color_depth`
+	bool auto_color_depth = true;
+
+	// per-stage frame timings, only allocated when requested so disabled timers are a null check
+	std::unique_ptr<FrameStats> stats;
+	bool stats_overlay = false;
+	std::string stats_json_file;
+
+	// the overlay text is only refreshed every `stats_overlay_interval` frames to keep it readable
+	static constexpr int stats_overlay_interval = 30;
+	std::string stats_overlay_text;
+
+	// bars, colors and the stereo layout
+	SpectrumDrawer drawer;
+
+	// frames of audio decoded into `ring` at once
+	static constexpr int decode_block = 1024;
 
 	// intermediate arrays
 	std::vector<float>
-		// timedata = std::vector<float>(sample_size),
-		audio_buffer = std::vector<float>(sample_size * sf.channels()),
-		spectrum = std::vector<float>(stereo ? (tsize.width / 2) : tsize.width);
+		// only the newly decoded frames; the analysis window's history lives in `history`
+		audio_buffer = std::vector<float>(decode_block * channels);
+	bool decoded_all = false;
 
-	// audio
-	PortAudio pa;
-	PortAudio::Stream pa_stream = pa.stream(0, sf.channels(), paFloat32, sf.samplerate(), sample_size);
+	// one spectrum per rendered channel: just one, or left and right when `stereo`
+	std::vector<std::vector<float>> spectra = std::vector<std::vector<float>>(1, std::vector<float>(tsize.width));
 
-	// color
-	ColorType color_type = ColorType::WHEEL;
-	std::tuple<int, int, int> solid_rgb{255, 0, 255};
+	// audio waiting to be played by `sink`'s callback
+	SpscRingBuffer ring{channels, ring_slack()};
 
-	// characters
-	char peak_char = 0;
-	std::string characters = "#";
+	// everything recently decoded into `ring`, deinterleaved once for analysis.
+	// the window of every frame is read from it in place, whatever the hop between frames
+	StftHistory history{channels, history_size()};
 
-	// color wheel rotation
-	struct
-	{
-		float time = 0, rate = 0;
-		std::tuple<float, float, float> hsv{0.9, 0.7, 1};
-	} wheel;
+	// spectra computed ahead of playback on `lookahead_jobs` threads, null when computed on the playback thread
+	int lookahead_jobs = 0;
+	std::unique_ptr<SpectrumPrefetcher> prefetcher;
+
+	// decoded audio in an mmaped cache file, played and analysed in place. null when decoding into `ring`
+	bool use_pcm_cache = false;
+	uintmax_t pcm_cache_size = (uintmax_t)4 << 30;
+	std::unique_ptr<PcmCache> pcm;
 
-	// spectrum - final multiplier
-	float multiplier = 3;
+	// every frame's spectra from an mmaped cache file, null when computed during playback
+	bool use_spectrum_cache = false;
+	uintmax_t spectrum_cache_size = 1 << 30;
+	std::unique_ptr<SpectrumCache> spectrum_cache;
 
-	// sane default for now
-	const int refresh_rate = 60;
-	const int audio_frames_per_video_frame = sf.samplerate() / refresh_rate;
+	// offline rendering: skips audio and the terminal entirely when `render_file` is set
+	std::string render_file;
+	RenderFormat render_format = RenderFormat::ASCIICAST;
+	int render_width = 0, render_height = 0, render_jobs = 0;
+
+	// where audio is played, only opened by `start` when playing.
+	// the null and wav sinks can run in real time or free-running, as fast as frames are rendered
+	AudioSink::Type sink_type = AudioSink::Type::PORTAUDIO;
+	std::string sink_wav_file;
+	bool sink_realtime = true;
+	std::unique_ptr<AudioSink> sink;
 
 public:
-	termviz(const std::string &audio_file) : sf(audio_file), fs(sample_size) {}
+	termviz(const std::string &audio_file)
+		: audio_file(audio_file),
+		  sf(audio_file),
+		  channels(sf.channels()),
+		  samplerate(sf.samplerate()),
+		  fs(sample_size)
+	{
+	}
+
+	/**
+	 * Play raw pcm streamed to stdin, e.g. from `ffmpeg -i ... -f f32le -`, instead of a file.
+	 * The stream is analysed as it arrives and never seeked, so the caches, lookahead and offline rendering,
+	 * which read ahead in a file, are not available.
+	 * @param format how the pcm is encoded
+	 */
+	termviz(const PcmPipe::Format &format)
+		: audio_file("-"),
+		  pipe(std::make_unique<PcmPipe>(STDIN_FILENO, format)),
+		  channels(format.channels),
+		  samplerate(format.samplerate),
+		  fs(sample_size)
+	{
+	}
 
 	/**
 	 * Start rendering the spectrum to the terminal!
+	 * If a render file was set with `set_render_file`, renders the whole file to it instead, without playing it.
 	 * @note Blocks until finished.
 	 */
 	void start()
 	{
-		std::cout << audio_frames_per_video_frame << '\n';
-		// exit(0);
-		for (int pos = 0; pos < sf.frames();)
+		if (pipe && (!render_file.empty() || use_pcm_cache || use_spectrum_cache || lookahead_jobs))
+			throw std::invalid_argument("offline rendering, the caches and lookahead need a seekable audio file, not stdin");
+		if (!sink_realtime && pipe)
+			throw std::invalid_argument("a free-running audio sink needs an audio file, stdin arrives in real time");
+
+		if (!render_file.empty())
+		{
+			render_offline();
+			return;
+		}
+
+		// before opening audio, since building a missing cache takes a moment
+		if (use_spectrum_cache)
+			spectrum_cache = std::make_unique<SpectrumCache>(audio_file, fs, sample_size, scheduler.get_timing(), spectrum_cache_size);
+
+		if (use_pcm_cache)
+		{
+			pcm = std::make_unique<PcmCache>(audio_file, pcm_cache_size);
+			sink = open_sink(play_from_pcm);
+		}
+		else
+		{
+			top_up_ring();
+			sink = open_sink(play_from_ring);
+		}
+		if (lookahead_jobs && !spectrum_cache)
+			start_prefetcher();
+
+		// measured before anything else is written, so the probe has the link to itself
+		if (auto_color_depth)
+			renderer.set_color_depth(TerminalLink::pick(TerminalLink::supported_depth(), TerminalLink::probe(STDOUT_FILENO),
+														tsize.width, tsize.height, fps()));
+		LinkMonitor link;
+
+		// the layout only changes on resize; catch one that happened since construction
+		ResizeSignal resize_signal;
+		update_layout();
+
+		// hide the cursor while rendering
+		out.append("\e[?25l");
+
+		for (int frame = 0;; ++frame)
 		{
+			const FrameStats::Timer frame_timer(stats.get(), FrameStats::FRAME);
+
 			// handleEvents();
-			check_tsize_update();
+			if (resize_signal.take())
+				update_layout();
 
-			const auto frames_read = sf.readf(audio_buffer.data(), sample_size);
-			if (!frames_read)
-				return;
-			try
+			if (pcm)
+				pcm->check();
+			else
 			{
-				pa_stream.write(audio_buffer.data(), audio_frames_per_video_frame);
+				// decoding is decoupled from the frame rate: every sample is decoded once, the file is never seeked
+				const FrameStats::Timer t(stats.get(), FrameStats::DECODE);
+				top_up_ring();
 			}
-			catch (const PortAudio::Error &e)
+
+			// wait until the audio clock reaches the next video frame.
+			// frames whose time already passed while the last one was rendered are dropped, so lag never builds up.
+			const auto previous = scheduler.last_frame();
+			std::optional<int64_t> due;
+			int64_t position;
 			{
-				// if (!strstr(e.what(), "Output underflowed"))
-					throw;
-				std::cerr << "Output underflowed\n";
+				const FrameStats::Timer t(stats.get(), FrameStats::AUDIO);
+				while (!(due = scheduler.due(position = audible())) && !finished())
+				{
+					if (sink_realtime)
+					{
+						const auto wait = std::min(scheduler.seconds_until_next(position), 0.01);
+						std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+					}
+					// a free-running sink plays up to the next frame right away, and only waits for decoding
+					else if (!sink->pump())
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					// keep the ring fed through long waits at low frame rates
+					if (!pcm)
+						top_up_ring();
+				}
 			}
-			if (frames_read != sample_size)
-				return;
+			if (!due)
+				break;
 
-			std::cout << "\ec";
-			if (color_type == ColorType::SOLID)
+			const std::vector<std::vector<float>> *frame_spectra = &spectra;
+			if (spectrum_cache)
 			{
-				// clearing the terminal also clears color modes
-				const auto [r, g, b] = solid_rgb;
-				std::cout << "\e[38;2;" << r << ';' << g << ';' << b << 'm';
+				// cached frame `k - 1`'s window ends where frame `k` starts, the latest one that has been heard
+				const FrameStats::Timer t(stats.get(), FrameStats::COPY);
+				spectrum_cache->read(std::max<int64_t>(0, *due - 1), spectra);
 			}
-
-			// copy_channel_to_input(1);
-			// fs.render(spectrum);
-			// renderer.SetDrawColor().Clear();
-			// render_spectrum_full();
-			// renderer.Present();
-
-			// if (stereo)
-			// 	for (int i = 1; i <= 2; ++i)
-			// 	{
-			// 		copy_channel_to_timedata(i);
-			// 		fs.render(spectrum);
-			// 		print_half(i);
-			// 	}
-			// else
+			else if (prefetcher)
 			{
-				copy_channel_to_timedata(1);
-				fs.render(spectrum);
-				print_spectrum_full();
-				std::cout.flush();
+				// only waits if the workers fell behind the playhead
+				const FrameStats::Timer t(stats.get(), FrameStats::COPY);
+				frame_spectra = &prefetcher->get(std::max<int64_t>(0, *due - 1));
+			}
+			else
+			{
+				{
+					// analyse what is being heard right now, not what was last handed to the device
+					const FrameStats::Timer t(stats.get(), FrameStats::COPY);
+					for (int i = 1; i <= (int)spectra.size(); ++i)
+						copy_channel_to_timedata(i, position);
+				}
+				fs.render(spectra);
 			}
 
-			pos += audio_frames_per_video_frame;
-			sf.seek(pos, SEEK_SET);
+			{
+				const FrameStats::Timer t(stats.get(), FrameStats::DRAW);
+				drawer.draw(renderer, *frame_spectra);
+				if (stats_overlay)
+				{
+					if (frame % stats_overlay_interval == 0)
+					{
+						stats_overlay_text = stats->overlay() + " | dropped " + std::to_string(scheduler.dropped_frames());
+						if (pipe)
+							stats_overlay_text += " | stdin overruns " + std::to_string(pipe->overruns());
+					}
+					renderer.draw_text(0, 0, stats_overlay_text, TerminalRenderer::DEFAULT_COLOR);
+				}
+			}
+			{
+				const FrameStats::Timer t(stats.get(), FrameStats::ENCODE);
+				renderer.present(out);
+			}
+			{
+				const FrameStats::Timer t(stats.get(), FrameStats::WRITE);
+				const auto begin = std::chrono::steady_clock::now();
+				out.flush();
+				// the palette tables are already built, so this only costs one full redraw
+				if (auto_color_depth && link.saturated(std::chrono::steady_clock::now() - begin) && renderer.get_color_depth() != ColorDepth::COLOR_16)
+					renderer.set_color_depth((ColorDepth)((int)renderer.get_color_depth() - 1));
+			}
 
-			wheel.time += wheel.rate;
+			// the wheel turns with time, including the frames that were dropped
+			drawer.advance_wheel((previous < 0) ? 1 : (*due - previous));
 
 			// return true;
 		}
-		std::cout << "\ec";
+		prefetcher.reset();
+		sink.reset();
+
+		// don't count the final reset as a frame
+		const auto total = out.all_frames();
+		const auto frames = out.frames_flushed();
+		out.append("\ec");
+		out.flush();
+
+		if (!stats || !frames)
+			return;
+
+		if (stats_overlay)
+		{
+			stats->print_summary(std::cerr);
+			std::cerr << "frames: " << frames
+					  << ", bytes/frame: " << total.bytes / frames
+					  << ", write syscalls/frame: " << (double)total.syscalls / frames
+					  << ", dropped frames: " << scheduler.dropped_frames()
+					  << ", color depth: " << color_depth_bits() << " bits"
+					  << ", audio underrun frames: " << underruns() << '\n';
+			if (pipe)
+				std::cerr << "stdin overruns: " << pipe->overruns() << ", back-pressure: " << pipe->backpressure() * 1e3 << "ms\n";
+		}
+
+		if (!stats_json_file.empty())
+		{
+			std::ofstream json(stats_json_file);
+			if (!json)
+				throw std::runtime_error("cannot open stats file: " + stats_json_file);
+			std::vector<std::pair<std::string, double>> extra{{"frames", frames},
+															  {"bytes_per_frame", (double)total.bytes / frames},
+															  {"write_syscalls_per_frame", (double)total.syscalls / frames},
+															  {"dropped_frames", scheduler.dropped_frames()},
+															  {"color_depth_bits", color_depth_bits()},
+															  {"audio_underrun_frames", underruns()}};
+			if (pipe)
+			{
+				extra.emplace_back("stdin_overruns", pipe->overruns());
+				extra.emplace_back("stdin_backpressure_ms", pipe->backpressure() * 1e3);
+			}
+			stats->write_json(json, extra);
+		}
 	}
 
 	/**
@@ -158,12 +364,78 @@ public:
 		this->sample_size = sample_size;
 		fs.set_fft_size(sample_size);
 		// timedata.resize(sample_size);
-		audio_buffer.resize(sample_size * sf.channels());
-		pa_stream.reopen(0, 2, paFloat32, sf.samplerate(), sample_size);
+		if (sink)
+			sink->stop();
+		ring.reset(ring_slack());
+		history.reset(history_size());
+		if (sink)
+			sink->start();
 		mutex.unlock();
 		return *this;
 	}
 
+	/**
+	 * Set the video frame rate. Need not be an integer (e.g. 59.94 or 143.856): frames are timed against the audio clock
+	 * without rounding the hop between them. Frames that can't be rendered in time are dropped rather than shown late.
+	 * @param fps new frame rate to use
+	 * @return reference to self
+	 * @throws `std::invalid_argument` if `fps` is not positive
+	 */
+	termviz &set_fps(const double fps)
+	{
+		scheduler = FrameScheduler(samplerate, fps);
+		return *this;
+	}
+
+	/**
+	 * Set the hop between video frames in audio frames, instead of a frame rate. Independent of the sample size:
+	 * windows overlap by `sample_size - hop` frames, and each frame only decodes `hop` new ones.
+	 * @param hop new hop to use, e.g. 256 to update a 16384 frame window at 172 fps at 44.1 kHz
+	 * @return reference to self
+	 * @throws `std::invalid_argument` if `hop` is not positive
+	 */
+	termviz &set_hop(const int hop)
+	{
+		scheduler = FrameScheduler(FrameTiming::from_hop(samplerate, hop));
+		return *this;
+	}
+
+	/**
+	 * Set how colors are sent to the terminal, instead of picking it from the terminal's capabilities and throughput.
+	 * Rgb colors are mapped to the nearest entry of the 256 or 16 color palette with precomputed tables.
+	 * @param depth new color depth to use
+	 * @return reference to self
+	 */
+	termviz &set_color_depth(const ColorDepth depth)
+	{
+		auto_color_depth = false;
+		renderer.set_color_depth(depth);
+		return *this;
+	}
+
+	/**
+	 * Set where audio is played. Without an audio device, the null sink discards it and the wav sink writes it to a file,
+	 * both timed like a device, so the whole pipeline runs the same in headless environments and containers.
+	 * Takes effect when `start` is called.
+	 * @param type `PORTAUDIO` for the default output device, `NULL_SINK` or `WAV`
+	 * @param wav_file file the `WAV` sink writes
+	 * @param realtime for the null and wav sinks: whether to play in real time, or free-running, where audio only
+	 * advances once the frame before has been rendered, so every frame is rendered as fast as possible and none are dropped
+	 * @return reference to self
+	 * @throws `std::invalid_argument` if `WAV` is given without a file, or `PORTAUDIO` isn't real time
+	 */
+	termviz &set_audio_sink(const AudioSink::Type type, const std::string &wav_file = {}, const bool realtime = true)
+	{
+		if (type == AudioSink::Type::WAV && wav_file.empty())
+			throw std::invalid_argument("the wav audio sink needs a file!");
+		if (type == AudioSink::Type::PORTAUDIO && !realtime)
+			throw std::invalid_argument("an audio device can only play in real time!");
+		sink_type = type;
+		sink_wav_file = wav_file;
+		sink_realtime = realtime;
+		return *this;
+	}
+
 	/**
 	 * Set the character(s) to print (in order) as the bar is printed upwards.
 	 * @param characters new characters to use
@@ -171,7 +443,7 @@ public:
 	 */
 	termviz &set_characters(const std::string &characters)
 	{
-		this->characters = characters;
+		drawer.set_characters(characters);
 		return *this;
 	}
 
@@ -182,7 +454,7 @@ public:
 	 */
 	termviz &set_peak_char(const char peak_char)
 	{
-		this->peak_char = peak_char;
+		drawer.set_peak_char(peak_char);
 		return *this;
 	}
 
@@ -193,7 +465,7 @@ public:
 	 */
 	termviz &set_color_type(const ColorType color_type)
 	{
-		this->color_type = color_type;
+		drawer.set_color_type(color_type);
 		return *this;
 	}
 
@@ -206,7 +478,7 @@ public:
 	 */
 	termviz &set_wheel_rate(const float rate)
 	{
-		wheel.rate = rate;
+		drawer.set_wheel_rate(rate);
 		return *this;
 	}
 
@@ -218,7 +490,34 @@ public:
 	 */
 	termviz &set_solid_color(const std::tuple<int, int, int> rgb)
 	{
-		this->solid_rgb = rgb;
+		drawer.set_solid_color(rgb);
+		return *this;
+	}
+
+	/**
+	 * Set the colors of the gradient to use when coloring the spectrum with a gradient.
+	 * You will only see the change if the color type is set to `GRADIENT`.
+	 * @param colors (red, green, blue) tuples, spread evenly from the left to the right of the spectrum
+	 * @param space whether to blend between colors in linear-light rgb or in hsv
+	 * @return reference to self
+	 * @throws `std::invalid_argument` if `colors` is empty or a channel is not in [0, 255]
+	 */
+	termviz &set_gradient(const std::vector<std::tuple<int, int, int>> &colors, const GradientSpace space)
+	{
+		std::vector<ColorUtils::Gradient::Stop> stops;
+		for (size_t i = 0; i < colors.size(); ++i)
+		{
+			const auto [r, g, b] = colors[i];
+			const float position = (colors.size() > 1) ? ((float)i / (colors.size() - 1)) : 0;
+			if (space == GradientSpace::HSV)
+			{
+				const auto [h, s, v] = ColorUtils::rgb_to_hsv(r / 255.f, g / 255.f, b / 255.f);
+				stops.push_back({position, h, s, v});
+			}
+			else
+				stops.push_back({position, r / 255.f, g / 255.f, b / 255.f});
+		}
+		drawer.set_gradient(ColorUtils::Gradient(space, std::move(stops)));
 		return *this;
 	}
 
@@ -230,7 +529,7 @@ public:
 	 */
 	termviz &set_wheel_hsv(const std::tuple<float, float, float> hsv)
 	{
-		wheel.hsv = hsv;
+		drawer.set_wheel_hsv(hsv);
 		return *this;
 	}
 
@@ -260,7 +559,7 @@ public:
 	 * Set the nth-root to use when using the `NTH_ROOT` scale.
 	 * @param nth_root new nth_root to use
 	 * @returns reference to self
-	 * @throws `std::invalid_argument` if `nth_root` is zero
+	 * @throws `std::invalid_argument` if `nth_root` is less than 1
 	 */
 	termviz &set_nth_root(const int nth_root)
 	{
@@ -292,6 +591,32 @@ public:
 		return *this;
 	}
 
+	/**
+	 * Set the beta (shape) parameter of the Kaiser window.
+	 * @param beta new beta to use
+	 * @returns reference to self
+	 * @throws `std::invalid_argument` if `beta` is negative
+	 */
+	termviz &set_kaiser_beta(const float beta)
+	{
+		fs.set_kaiser_beta(beta);
+		return *this;
+	}
+
+	/**
+	 * Set how hard fftw should look for a fast plan.
+	 * Measured plans are saved as fftw wisdom in the cache directory, so they are only computed once per machine and sample size.
+	 * @param rigor new planner rigor to use
+	 * @returns reference to self
+	 */
+	termviz &set_fft_planner(const PlannerRigor rigor)
+	{
+		if (rigor != PlannerRigor::ESTIMATE && fftwf_dft_r2c_1d::wisdom_file.empty())
+			fftwf_dft_r2c_1d::wisdom_file = CacheDir::path() / "fftwf-wisdom";
+		fs.set_planner_rigor(rigor);
+		return *this;
+	}
+
 	/**
 	 * Set the multiplier to multiply the spectrum's height by.
 	 * @param multiplier new multiplier to use
@@ -299,7 +624,32 @@ public:
 	 */
 	termviz &set_multiplier(const float multiplier)
 	{
-		this->multiplier = multiplier;
+		drawer.set_multiplier(multiplier);
+		return *this;
+	}
+
+	/**
+	 * Time every stage of each frame, show a summary line on the top row while playing,
+	 * and print per-stage p50/p99/max latencies plus output totals to stderr when playback ends.
+	 * @param b whether to show and print stats
+	 * @return reference to self
+	 */
+	termviz &set_stats_overlay(const bool b)
+	{
+		stats_overlay = b;
+		update_stats();
+		return *this;
+	}
+
+	/**
+	 * Time every stage of each frame and dump the latency histograms as JSON to `path` when playback ends.
+	 * @param path file to write, or empty to disable
+	 * @return reference to self
+	 */
+	termviz &set_stats_json(const std::string &path)
+	{
+		stats_json_file = path;
+		update_stats();
 		return *this;
 	}
 
@@ -309,34 +659,346 @@ public:
 	 */
 	termviz &set_stereo(const bool b)
 	{
-		stereo = b;
+		drawer.set_stereo(b);
+		fs.set_channels(drawer.spectrum_count());
+		spectra.assign(drawer.spectrum_count(), std::vector<float>(drawer.spectrum_width(tsize.width)));
+		return *this;
+	}
+
+	/**
+	 * Compute spectra ahead of the playhead on a pool of threads, so the playback thread only draws, encodes and writes.
+	 * Takes effect when `start` is called. The window, fft, bin mapping and interpolation stages are then not timed by stats.
+	 * @param jobs number of threads, 0 to compute every spectrum on the playback thread
+	 * @return reference to self
+	 */
+	termviz &set_lookahead_jobs(const int jobs)
+	{
+		if (jobs < 0)
+			throw std::invalid_argument("lookahead jobs cannot be negative!");
+		lookahead_jobs = jobs;
+		return *this;
+	}
+
+	/**
+	 * Decode the audio file once into an mmaped float32 pcm file in the cache directory, on a background thread,
+	 * and play and analyse straight from the mapping. Later plays of the same file skip decoding entirely.
+	 * Takes effect when `start` is called.
+	 * @param b whether to use the pcm cache
+	 * @return reference to self
+	 */
+	termviz &set_pcm_cache(const bool b)
+	{
+		use_pcm_cache = b;
+		return *this;
+	}
+
+	/**
+	 * Set the size cap of the pcm cache directory. Least recently played files are evicted past it.
+	 * @param bytes new size cap
+	 * @return reference to self
+	 */
+	termviz &set_pcm_cache_size(const uintmax_t bytes)
+	{
+		pcm_cache_size = bytes;
+		return *this;
+	}
+
+	/**
+	 * Play from an on-disk cache of every frame's spectra, building it first if this file hasn't been played
+	 * with the same analysis settings before. Takes effect when `start` is called.
+	 * Spectra are cached at `SpectrumCache::width` columns and resampled to the terminal's width.
+	 * @param b whether to use the cache
+	 * @return reference to self
+	 */
+	termviz &set_spectrum_cache(const bool b)
+	{
+		use_spectrum_cache = b;
+		return *this;
+	}
+
+	/**
+	 * Set the size cap of the spectrum cache directory. Least recently played files are evicted past it.
+	 * @param bytes new size cap
+	 * @return reference to self
+	 */
+	termviz &set_spectrum_cache_size(const uintmax_t bytes)
+	{
+		spectrum_cache_size = bytes;
+		return *this;
+	}
+
+	/**
+	 * Render every frame of the audio file to `path` instead of playing it, as fast as possible on all cores.
+	 * @param path file to write when `start` is called, or empty to play normally
+	 * @return reference to self
+	 */
+	termviz &set_render_file(const std::string &path)
+	{
+		render_file = path;
+		return *this;
+	}
+
+	/**
+	 * Set the format `set_render_file`'s file is written in.
+	 * @param format `ASCIICAST` for an asciicast v2 recording with frame timestamps, `ANSI` for the raw terminal output
+	 * @return reference to self
+	 */
+	termviz &set_render_format(const RenderFormat format)
+	{
+		render_format = format;
+		return *this;
+	}
+
+	/**
+	 * Set the grid size used when rendering to a file. Defaults to the terminal's size, or 80x24 without a terminal.
+	 * @param width width in columns
+	 * @param height height in rows
+	 * @return reference to self
+	 * @throws `std::invalid_argument` if either is not positive
+	 */
+	termviz &set_render_size(const int width, const int height)
+	{
+		if (width <= 0 || height <= 0)
+			throw std::invalid_argument("render size must be positive!");
+		render_width = width;
+		render_height = height;
+		return *this;
+	}
+
+	/**
+	 * Set the number of threads used when rendering to a file.
+	 * @param jobs thread count, 0 for one per core
+	 * @return reference to self
+	 */
+	termviz &set_render_jobs(const int jobs)
+	{
+		render_jobs = jobs;
 		return *this;
 	}
 
 private:
-	void check_tsize_update()
+	void render_offline()
+	{
+		const auto width = render_width ? render_width : tsize.width;
+		const auto height = render_height ? render_height : tsize.height;
+		const auto begin = std::chrono::steady_clock::now();
+		const auto frames = OfflineRenderer(audio_file, fs, drawer, sample_size, scheduler.get_timing(), width, height)
+								.render(render_file, render_format, render_jobs);
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+		std::cerr << "rendered " << frames << " frames (" << (double)sf.frames() / sf.samplerate() << "s of audio) in "
+				  << elapsed.count() << "s, " << frames / elapsed.count() << " frames/s\n";
+	}
+
+	// only collect stats if something is going to show them
+	void update_stats()
+	{
+		if (!stats_overlay && stats_json_file.empty())
+			stats.reset();
+		else if (!stats)
+			stats = std::make_unique<FrameStats>();
+		fs.set_stats(stats.get());
+	}
+
+	// (re)start the workers at the playhead, with the current spectrum width
+	void start_prefetcher()
+	{
+		const auto start_frame = playhead_frame();
+		prefetcher.reset();
+		prefetcher = std::make_unique<SpectrumPrefetcher>(audio_file, fs, drawer.spectrum_width(tsize.width),
+														  sample_size, scheduler.get_timing(), lookahead_jobs, start_frame);
+	}
+
+	double fps() const
+	{
+		return scheduler.get_timing().fps();
+	}
+
+	// the video frame whose analysis window ends closest before what was just played
+	long playhead_frame() const
+	{
+		return std::max<long>(0, scheduler.get_timing().frame_at(playhead()) - 1);
+	}
+
+	// frames of audio played so far
+	size_t playhead() const
+	{
+		return pcm ? pcm->playhead() : ring.consumed();
+	}
+
+	// frames of audio heard so far: the audio clock extrapolated to now, which trails the playhead by the output latency
+	int64_t audible() const
+	{
+		const int64_t played = playhead();
+		const auto position = clock.position(sink->time(), samplerate);
+		return position ? std::min(*position, played) : played;
+	}
+
+	// everything was played, and heard: the audio clock caught up with the playhead,
+	// so the frames for the last output latency's worth of audio were shown too
+	bool finished() const
 	{
-		const TerminalSize new_tsize;
+		const auto played_all = pcm ? pcm->finished() : (decoded_all && !ring.readable());
+		return played_all && audible() >= (int64_t)playhead();
+	}
+
+	int color_depth_bits() const
+	{
+		switch (renderer.get_color_depth())
+		{
+		case ColorDepth::COLOR_16:
+			return 4;
+		case ColorDepth::COLOR_256:
+			return 8;
+		default:
+			return 24;
+		}
+	}
+
+	size_t underruns() const
+	{
+		return pcm ? pcm->underruns() : ring.underruns();
+	}
+
+	// query the terminal's size and rebuild everything that depends on it, once per resize.
+	// the bin map, column colors and interpolation workspace follow the new width on the next frame
+	void update_layout()
+	{
+		const TerminalSize new_tsize(tsize.width, tsize.height);
 
 		if (tsize.width != new_tsize.width)
 		{
-			spectrum.resize(stereo ? (new_tsize.width / 2) : new_tsize.width);
+			for (auto &spectrum : spectra)
+				spectrum.resize(drawer.spectrum_width(new_tsize.width));
 			tsize.width = new_tsize.width;
+			if (prefetcher)
+				start_prefetcher();
 		}
 
 		if (tsize.height != new_tsize.height)
 			tsize.height = new_tsize.height;
+
+		if (renderer.get_width() != tsize.width || renderer.get_height() != tsize.height)
+			renderer.resize(tsize.width, tsize.height);
 	}
 
-	void copy_channel_to_timedata(const int channel_num)
+	// copies the `sample_size` frames of a channel played before `window_end` into the fft input of the same channel.
+	// if the audio has fewer channels, its last channel is used instead.
+	// without the pcm cache, they are windowed straight from `history`, which only holds the most recently decoded frames,
+	// so `window_end` is clamped to it.
+	void copy_channel_to_timedata(const int channel_num, const size_t window_end)
 	{
 		if (channel_num <= 0)
 			throw std::invalid_argument("channel_num <= 0");
-		if (channel_num > sf.channels())
-			throw std::invalid_argument("channel_num > sf.channels()");
-		const auto input = fs.input_array();
-		for (int i = 0; i < sample_size; ++i)
-			input[i] = audio_buffer[i * sf.channels() + channel_num];
+		if (channel_num > fs.get_channels())
+			throw std::invalid_argument("channel_num > fs.get_channels()");
+		if (pcm)
+			pcm->read_window(fs.input_array(channel_num - 1), window_end, sample_size, std::min(channel_num, channels) - 1);
+		else
+		{
+			const auto end = history.end();
+			const auto oldest_end = end - std::min<uint64_t>(end, history.get_capacity() - sample_size);
+			const auto samples = history.window(std::min(channel_num, channels) - 1, std::clamp<uint64_t>(window_end, oldest_end, end), sample_size);
+			fs.load_windowed(channel_num - 1, samples);
+		}
+	}
+
+	// decode into the ring until it is full or the file ends
+	void top_up_ring()
+	{
+		if (pipe)
+		{
+			// only what has arrived; if the ring fills up first, the pipe fills up and holds the writer back
+			while (const auto room = ring.writable())
+			{
+				const auto frames_read = pipe->read(audio_buffer.data(), std::min<size_t>(room, decode_block));
+				if (!frames_read)
+					break;
+				ring.write(audio_buffer.data(), frames_read);
+				history.append(audio_buffer.data(), frames_read);
+			}
+			decoded_all = pipe->eof();
+			if (decoded_all)
+				ring.close();
+			pipe->set_held_back(!ring.writable() && pipe->pending());
+			return;
+		}
+
+		// in blocks of at most `decode_block`, since at low sample rates the whole ring can be smaller than one
+		while (const auto room = decoded_all ? 0 : ring.writable())
+		{
+			const auto frames_read = sf.readf(audio_buffer.data(), std::min<size_t>(room, decode_block));
+			if (!frames_read)
+			{
+				decoded_all = true;
+				ring.close();
+			}
+			ring.write(audio_buffer.data(), frames_read);
+			history.append(audio_buffer.data(), frames_read);
+		}
+	}
+
+	// how far ahead of playback the main loop may decode (250ms),
+	// which is how long a frame can stall before audio underflows
+	size_t ring_slack() const
+	{
+		return samplerate / 4;
+	}
+
+	// frames kept in `history`: everything decoded ahead of the playhead (at most the ring's capacity),
+	// then the analysis window plus up to 250ms of output latency behind it,
+	// since the window ends at what is being heard, not at what was last handed to the device
+	size_t history_size() const
+	{
+		return std::bit_ceil(ring_slack()) + sample_size + samplerate / 4;
+	}
+
+	std::unique_ptr<AudioSink> open_sink(const AudioSink::Callback callback)
+	{
+		switch (sink_type)
+		{
+		case AudioSink::Type::NULL_SINK:
+			return std::make_unique<NullSink>(channels, samplerate, callback, this, sink_realtime);
+		case AudioSink::Type::WAV:
+			return std::make_unique<WavSink>(sink_wav_file, channels, samplerate, callback, this, sink_realtime);
+		default:
+			return std::make_unique<PortAudioSink>(channels, samplerate, callback, this);
+		}
+	}
+
+	// frames a free-running sink may play from `position` on: only up to where the frame after the last rendered one starts.
+	// only called from `pump`, on the playback thread
+	size_t free_running_limit(const size_t n_frames, const uint64_t position, const uint64_t available) const
+	{
+		const auto until = scheduler.get_timing().start(scheduler.last_frame() + 1);
+		return std::min<uint64_t>({n_frames, available, (uint64_t)std::max<int64_t>(0, until - (int64_t)position)});
+	}
+
+	// sink callback: plays what the main loop pushed to the ring, silence on underrun
+	static size_t play_from_ring(float *const output, size_t frame_count, const double time, void *const user_data)
+	{
+		const auto self = static_cast<termviz *>(user_data);
+		const auto position = self->ring.consumed();
+		// record which frame of audio will be heard at the start of this buffer, and when.
+		// a buffer of nothing but underrun silence has no audio to place, and would hold the clock back behind the playhead
+		if (time >= 0 && self->ring.readable())
+			self->clock.update(position, time);
+		if (!self->sink_realtime)
+			frame_count = self->free_running_limit(frame_count, position, self->ring.readable());
+		self->ring.read(output, frame_count);
+		return frame_count;
+	}
+
+	// sink callback: plays straight from the decoded pcm mapping
+	static size_t play_from_pcm(float *const output, size_t frame_count, const double time, void *const user_data)
+	{
+		const auto self = static_cast<termviz *>(user_data);
+		const auto position = self->pcm->playhead();
+		if (time >= 0 && position < self->pcm->decoded_frames())
+			self->clock.update(position, time);
+		if (!self->sink_realtime)
+			frame_count = self->free_running_limit(frame_count, position, self->pcm->decoded_frames() - position);
+		self->pcm->play(output, frame_count);
+		return frame_count;
 	}
 
 	// bool render_frame()
@@ -387,86 +1049,4 @@ private:
 	// 	mutex.unlock();
 	// 	return true;
 	// }
-
-	void print_spectrum_full()
-	{
-		for (int i = 0; i < tsize.width; ++i)
-		{
-			if (color_type == ColorType::WHEEL)
-				apply_wheel_coloring(i, [this](const int i)
-									 { return (float)i / tsize.width; });
-			move_to_column(i);
-			print_bar(multiplier * spectrum[tsize.width - i] * tsize.height);
-		}
-	}
-
-	void print_spectrum_full_backwards()
-	{
-		for (int i = tsize.width - 1; i >= 0; --i)
-		{
-			if (color_type == ColorType::WHEEL)
-				apply_wheel_coloring(i, [this](const int i)
-									 { return (float)(tsize.width - i) / tsize.width; });
-			move_to_column(i);
-			print_bar(multiplier * spectrum[tsize.width - i] * tsize.height);
-		}
-	}
-
-	void print_half(int half)
-	{
-		const auto half_width = tsize.width / 2;
-
-		if (half == 1)
-			for (int i = half_width; i >= 0; --i)
-			{
-				if (color_type == ColorType::WHEEL)
-					apply_wheel_coloring(i, [half_width](const int i)
-										 { return (float)(half_width - i) / half_width; });
-				move_to_column(i);
-				print_bar(multiplier * spectrum[half_width - i] * tsize.height);
-			}
-
-		else if (half == 2)
-			for (int i = half_width; i < tsize.width; ++i)
-			{
-				if (color_type == ColorType::WHEEL)
-					apply_wheel_coloring(i, [half_width](const int i)
-										 { return (float)i / half_width; });
-				move_to_column(i);
-				print_bar(multiplier * spectrum[i - half_width] * tsize.height);
-			}
-	}
-
-	void apply_wheel_coloring(const int i, const std::function<float(int)> &ratio_calc)
-	{
-		if (color_type != ColorType::WHEEL)
-			throw std::logic_error("termviz::apply_wheel_coloring: color_type != ColorType::WHEEL");
-		const auto [h, s, v] = wheel.hsv;
-		const auto [r, g, b] = ColorUtils::hsvToRgb(ratio_calc(i) + h + wheel.time, s, v);
-		std::cout << "\e[38;2;" << r << ';' << g << ';' << b << 'm';
-	}
-
-	void move_to_column(const int i)
-	{
-		// move cursor to (height, i)
-		// remember that (0, 0) in a terminal is the top-left corner, so positive y moves the cursor down.
-		std::cout << "\e[" << tsize.height << ';' << i << 'f';
-	}
-
-	void print_bar(const int height)
-	{
-		if (!height)
-			return;
-
-		// height = (int)height;
-		int j = 0;
-
-		// until height - 1 to account for peak_char
-		for (; j < height - 1; ++j)
-			// print character, move cursor up 1, move cursor left 1
-			std::cout << characters[j % characters.length()] << "\e[1A\e[1D";
-
-		// print peak_char if set, otherwise next character in characters
-		std::cout << (peak_char ? peak_char : characters[j % characters.length()]);
-	}
-};
\ No newline at end of file
+};